@@ -17,19 +17,29 @@ extern "C"
 #include <string.h>
 
 //#ifdef GCC_MEGA_AVR
+#ifndef DUINOS_POSIX_PORT
 	/* EEPROM routines used only with the WinAVR compiler. */
 	#include <avr/eeprom.h>
+#endif
 //#endif
 
 /* Scheduler include files. */
 #include "DuinOS/FreeRTOS.h"
 #include "DuinOS/task.h"
+#include "DuinOS/pendcall.h"
+#include "DuinOS/periodic.h"
+#include "DuinOS/active.h"
 #include "DuinOS/duinos_main.h"
 
 #ifdef __cplusplus
 } // extern "C"
 #endif
 
+//Typed tasks, queues and semaphores in static storage, if configUSE_STATIC_ALLOCATION is 1:
+#include "DuinOS/static_rtos.h"
+//Scoped interrupt, tick and scheduler locks:
+#include "DuinOS/guard.h"
+
 extern unsigned portBASE_TYPE mainLoopPriority;
 
 //In small devices, we use only 3 priorities:
@@ -37,6 +47,20 @@ extern unsigned portBASE_TYPE mainLoopPriority;
 #define NORMAL_PRIORITY		(tskIDLE_PRIORITY + 1)
 #define HIGH_PRIORITY		(tskIDLE_PRIORITY + 2)
 
+//Bigger devices may have up to 16 priorities (configUSE_PRIORITY_BITMAP in FreeRTOSConfig.h). The ones above
+//HIGH_PRIORITY are split in four named bands, from the lowest to the highest, each PRIORITY_BAND_SIZE levels
+//wide, ie: CONTROL_PRIORITY + 1. With 16 priorities the bands are 3 levels wide, and the top priority is left
+//for the kernel's own tasks:
+#if configUSE_PRIORITY_BITMAP
+	#if configMAX_PRIORITIES >= 8
+		#define PRIORITY_BAND_SIZE		((configMAX_PRIORITIES - 4) / 4)
+		#define HOUSEKEEPING_PRIORITY	(HIGH_PRIORITY + 1)
+		#define LOGGING_PRIORITY		(HOUSEKEEPING_PRIORITY + PRIORITY_BAND_SIZE)
+		#define CONTROL_PRIORITY		(LOGGING_PRIORITY + PRIORITY_BAND_SIZE)
+		#define COMMS_PRIORITY			(CONTROL_PRIORITY + PRIORITY_BAND_SIZE)
+	#endif
+#endif
+
 #define taskLoop(name)\
 void name##Function();\
 xTaskHandle name;\
@@ -47,18 +71,39 @@ void name##_Task(void *pvParameters)\
 }\
 void name##Function()
 
+//Like taskLoop(), but the body runs once every period_ms milliseconds (at least one tick), released by
+//vTaskDelayUntil(). The task also keeps its release jitter, execution time and overruns in name##Stats, see
+//DuinOS/periodic.h. It's created with createTaskLoop() too:
+#define periodicTaskLoop(name, period_ms)\
+void name##Function();\
+xTaskHandle name;\
+xPeriodicStats name##Stats;\
+void name##_Task(void *pvParameters)\
+{\
+	portTickType lastRelease = xTaskGetTickCount();\
+	for(;;)\
+	{\
+		vTaskDelayUntil(&lastRelease, portMS_TO_TICKS(period_ms));\
+		vPeriodicTaskRelease(&name##Stats, lastRelease);\
+		name##Function();\
+		vPeriodicTaskComplete(&name##Stats, lastRelease, portMS_TO_TICKS(period_ms));\
+	}\
+}\
+void name##Function()
+
 //This macro enables the forward declaration of a task, to allow other tasks previous defined (with the
 //taskLoop()macro use and reference them:
 #define declareTaskLoop(name) extern xTaskHandle name
+#define declarePeriodicTaskLoop(name) extern xTaskHandle name; extern xPeriodicStats name##Stats
 
 #define createTaskLoop(name, priority)\
 {\
-	xTaskCreate(name##_Task, (signed portCHAR *) #name, configMINIMAL_STACK_SIZE, NULL, priority, &name);\
+	xTaskCreate(name##_Task, tskTASK_NAME(#name), configMINIMAL_STACK_SIZE, NULL, priority, &name);\
 }
 
 #define createTaskLoopWithStackSize(name, priority, ssize)\
 {\
-	xTaskCreate(name##_Task, (signed portCHAR *) #name, ssize, NULL, priority, &name);\
+	xTaskCreate(name##_Task, tskTASK_NAME(#name), ssize, NULL, priority, &name);\
 }
 
 #define suspend() vTaskSuspend(NULL)
@@ -79,12 +124,12 @@ inline void delay(const unsigned long ms)
 {
 #ifndef NO_FANCY_DELAY_FUNCTION
   if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
-    vTaskDelay(ms / portTICK_RATE_MS);
+    vTaskDelay(portMS_TO_TICKS(ms));
   } else {
     wiring_delay(ms);
   }
 #else
-  vTaskDelay(ms / portTICK_RATE_MS);
+  vTaskDelay(portMS_TO_TICKS(ms));
 #endif
 }
 
@@ -104,4 +149,42 @@ inline void delay(const unsigned long ms)
 
 //##In bigger CPUs, DuinOS may use cTaskDelete, and uxTaskPrioritySet/Get.
 
+//Statistics of a periodicTaskLoop(), safe to read from any task. Times are in tick fractions,
+//periodicMicros() converts them to microseconds:
+#define getPeriodicStats(name, stats) vPeriodicStatsGet(&name##Stats, &(stats))
+#define resetPeriodicStats(name) vPeriodicStatsReset(&name##Stats)
+#define periodicMicros(fractions) portTICK_FRACTION_TO_US(fractions)
+#ifdef __cplusplus
+	class Print;
+	//Prints them to a stream, ie: dumpPeriodicStats(Serial, control):
+	#define dumpPeriodicStats(out, name) dumpPeriodicTask(out, #name, &name##Stats)
+	void dumpPeriodicTask(Print &out, const char *name, const xPeriodicStats *stats);
+#endif
+
+//These only works if configUSE_CPU_LOAD is 1 in FreeRTOSConfig.h. They return the processor load in percent,
+//over the last second and averaged over the last 10 and 60 seconds:
+#if configUSE_CPU_LOAD
+	#define cpuLoad1s() uxTaskGetCpuLoad(tskCPU_LOAD_1S)
+	#define cpuLoad10s() uxTaskGetCpuLoad(tskCPU_LOAD_10S)
+	#define cpuLoad60s() uxTaskGetCpuLoad(tskCPU_LOAD_60S)
+	#ifdef __cplusplus
+		class Print;
+		//Prints them to a stream, ie: dumpCpuLoad(Serial) to report over USB:
+		void dumpCpuLoad(Print &out);
+	#endif
+#endif
+
+//These only works if configUSE_CRITICAL_SECTION_TRACKING is 1 in FreeRTOSConfig.h. They report the longest
+//time interrupts were kept off (kernel critical sections and the cli() sections of the core), and where:
+#if configUSE_CRITICAL_SECTION_TRACKING
+	#ifdef __cplusplus
+		class Print;
+		//Prints it to a stream, ie: dumpCriticalSections(Serial):
+		void dumpCriticalSections(Print &out);
+	#endif
+	#define criticalMaxCycles() ulPortCriticalMaxCycles()
+	#define criticalMaxAddress() ulPortCriticalMaxSite()
+	#define resetCriticalSections() vPortCriticalReset()
+#endif
+
 #endif
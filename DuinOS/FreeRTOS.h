@@ -144,6 +144,18 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 	#define configUSE_MUTEXES 0
 #endif
 
+#ifndef configUSE_PRIORITY_BITMAP
+	#define configUSE_PRIORITY_BITMAP 0
+#endif
+
+#ifndef configUSE_CPU_LOAD
+	#define configUSE_CPU_LOAD 0
+#endif
+
+#ifndef configUSE_MUTEX_PRIORITY_CEILING
+	#define configUSE_MUTEX_PRIORITY_CEILING 0
+#endif
+
 #ifndef configUSE_COUNTING_SEMAPHORES
 	#define configUSE_COUNTING_SEMAPHORES 0
 #endif
@@ -164,6 +176,69 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 	#define configIDLE_SHOULD_YIELD		1
 #endif
 
+#ifndef configUSE_PROGMEM_TASK_NAMES
+	#define configUSE_PROGMEM_TASK_NAMES 0
+#endif
+
+#ifndef configUSE_COMPACT_LIST_ITEMS
+	#define configUSE_COMPACT_LIST_ITEMS 0
+#endif
+
+#ifndef configUSE_CRITICAL_SECTION_TRACKING
+	#define configUSE_CRITICAL_SECTION_TRACKING 0
+#endif
+
+#ifndef configUSE_PEND_CALL_TASK
+	#define configUSE_PEND_CALL_TASK 0
+#endif
+
+#ifndef configPEND_CALL_QUEUE_LENGTH
+	#define configPEND_CALL_QUEUE_LENGTH 4
+#endif
+
+#ifndef configPEND_CALL_TASK_PRIORITY
+	#define configPEND_CALL_TASK_PRIORITY ( configMAX_PRIORITIES - 1 )
+#endif
+
+#ifndef configPEND_CALL_STACK_SIZE
+	#define configPEND_CALL_STACK_SIZE configMINIMAL_STACK_SIZE
+#endif
+
+#ifndef configUSE_STATIC_ALLOCATION
+	#define configUSE_STATIC_ALLOCATION 0
+#endif
+
+#ifndef configUSE_ACTIVE_OBJECTS
+	#define configUSE_ACTIVE_OBJECTS 0
+#endif
+
+#ifndef configACTIVE_MAX_OBJECTS
+	#define configACTIVE_MAX_OBJECTS 8
+#endif
+
+#ifndef configACTIVE_MAX_SIGNALS
+	#define configACTIVE_MAX_SIGNALS 16
+#endif
+
+#if ( configUSE_COMPACT_LIST_ITEMS == 1 ) && ( configUSE_CO_ROUTINES == 1 )
+	#error configUSE_COMPACT_LIST_ITEMS cannot be used with co-routines, croutine.c reads the list item owner directly.
+#endif
+
+#if ( configUSE_PRIORITY_BITMAP == 1 )
+	/* configMAX_PRIORITIES must then be a plain number. */
+	#if configMAX_PRIORITIES > 16
+		#error configUSE_PRIORITY_BITMAP supports up to 16 priorities.
+	#endif
+#endif
+
+#if ( configUSE_ACTIVE_OBJECTS == 1 ) && ( configACTIVE_MAX_OBJECTS > 16 )
+	#error configUSE_ACTIVE_OBJECTS supports up to 16 active objects.
+#endif
+
+#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 ) && ( configUSE_MUTEXES == 0 )
+	#error configUSE_MUTEX_PRIORITY_CEILING requires configUSE_MUTEXES.
+#endif
+
 #if configMAX_TASK_NAME_LEN < 1
 	#undef configMAX_TASK_NAME_LEN
 	#define configMAX_TASK_NAME_LEN 1
@@ -396,5 +471,60 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 	#define configUSE_MALLOC_FAILED_HOOK 0
 #endif
 
+/*
+ * Storage for the TCB of a task created with xTaskCreateStatic(), and for a
+ * queue created with xQueueCreateStatic().  They have the sizes of the private
+ * structures of tasks.c and queue.c, which check them at compile time, and
+ * must not be accessed directly.
+ */
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+
+	#include "list.h"
+
+	typedef struct xSTATIC_TASK
+	{
+		void					*pvDummy1;
+		xListItem				xDummy2[ 2 ];
+		unsigned portBASE_TYPE	uxDummy3;
+		void					*pvDummy4;
+		#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+			const void			*pvDummy5;
+		#else
+			signed portCHAR		ucDummy5[ configMAX_TASK_NAME_LEN ];
+		#endif
+		#if ( portSTACK_GROWTH > 0 )
+			void				*pvDummy6;
+		#endif
+		#if ( portCRITICAL_NESTING_IN_TCB == 1 )
+			unsigned portBASE_TYPE	uxDummy7;
+		#endif
+		#if ( configUSE_TRACE_FACILITY == 1 )
+			unsigned portBASE_TYPE	uxDummy8;
+		#endif
+		#if ( configUSE_MUTEXES == 1 )
+			unsigned portBASE_TYPE	uxDummy9;
+		#endif
+		#if ( configUSE_APPLICATION_TASK_TAG == 1 )
+			void				*pvDummy10;
+		#endif
+		#if ( configGENERATE_RUN_TIME_STATS == 1 )
+			unsigned portLONG	ulDummy11;
+		#endif
+		unsigned portCHAR		ucDummy12;
+	} xStaticTask;
+
+	typedef struct xSTATIC_QUEUE
+	{
+		void					*pvDummy1[ 4 ];
+		xList					xDummy2[ 2 ];
+		unsigned portBASE_TYPE	uxDummy3[ 3 ];
+		signed portBASE_TYPE	xDummy4[ 2 ];
+		#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+			unsigned portBASE_TYPE	uxDummy5;
+		#endif
+	} xStaticQueue;
+
+#endif
+
 #endif /* INC_FREERTOS_H */
 
@@ -0,0 +1,376 @@
+/*
+	Active objects for DuinOS, see active.h.
+*/
+
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "active.h"
+
+#if ( configUSE_ACTIVE_OBJECTS == 1 )
+
+/* Every object, by subscriber bit. */
+static xActiveObject *pxActiveObjects[ configACTIVE_MAX_OBJECTS ];
+static unsigned portBASE_TYPE uxActiveObjectCount = 0;
+
+/* The objects subscribed to each signal, one bit per object. */
+static unsigned portSHORT usActiveSubscribers[ configACTIVE_MAX_SIGNALS ];
+
+static const xActiveEvent xActiveEntryEvent = { activeSIG_ENTRY, 0, NULL };
+static const xActiveEvent xActiveExitEvent = { activeSIG_EXIT, 0, NULL };
+
+/*
+ * Event reference counting.  Must be called with interrupts disabled.  The
+ * last release puts a pool event back on the free list of its pool, whose
+ * first bytes hold the link.
+ */
+static void prvEventReference( const xActiveEvent *pxEvent );
+static void prvEventRelease( const xActiveEvent *pxEvent );
+
+/*-----------------------------------------------------------*/
+
+static void prvEventReference( const xActiveEvent *pxEvent )
+{
+	if( pxEvent->pxPool != NULL )
+	{
+		( ( xActiveEvent * ) pxEvent )->ucReferences++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvEventRelease( const xActiveEvent *pxEvent )
+{
+xEventPool *pxPool = pxEvent->pxPool;
+
+	if( pxPool != NULL )
+	{
+		if( pxEvent->ucReferences > 0 )
+		{
+			( ( xActiveEvent * ) pxEvent )->ucReferences--;
+		}
+
+		if( pxEvent->ucReferences == 0 )
+		{
+			*( void ** ) pxEvent = pxPool->pvFree;
+			pxPool->pvFree = ( void * ) pxEvent;
+			pxPool->uxFree++;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vEventPoolInitialise( xEventPool *pxPool, void *pvBlocks, size_t uxBlockSize, unsigned portBASE_TYPE uxBlocks )
+{
+unsigned portCHAR *pucBlock = ( unsigned portCHAR * ) pvBlocks;
+unsigned portBASE_TYPE uxBlock;
+
+	portENTER_CRITICAL();
+	{
+		pxPool->pvFree = NULL;
+		for( uxBlock = 0; uxBlock < uxBlocks; uxBlock++ )
+		{
+			*( void ** ) pucBlock = pxPool->pvFree;
+			pxPool->pvFree = ( void * ) pucBlock;
+			pucBlock += uxBlockSize;
+		}
+		pxPool->uxFree = uxBlocks;
+		pxPool->uxMinFree = uxBlocks;
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+xActiveEvent *pxActiveEventNewFromISR( xEventPool *pxPool, unsigned portCHAR ucSignal )
+{
+xActiveEvent *pxEvent = ( xActiveEvent * ) pxPool->pvFree;
+
+	if( pxEvent != NULL )
+	{
+		pxPool->pvFree = *( void ** ) pxEvent;
+		pxPool->uxFree--;
+		if( pxPool->uxFree < pxPool->uxMinFree )
+		{
+			pxPool->uxMinFree = pxPool->uxFree;
+		}
+
+		pxEvent->ucSignal = ucSignal;
+		pxEvent->ucReferences = 0;
+		pxEvent->pxPool = pxPool;
+	}
+
+	return pxEvent;
+}
+/*-----------------------------------------------------------*/
+
+xActiveEvent *pxActiveEventNew( xEventPool *pxPool, unsigned portCHAR ucSignal )
+{
+xActiveEvent *pxEvent;
+
+	portENTER_CRITICAL();
+	{
+		pxEvent = pxActiveEventNewFromISR( pxPool, ucSignal );
+	}
+	portEXIT_CRITICAL();
+
+	return pxEvent;
+}
+/*-----------------------------------------------------------*/
+
+void vActiveEventRelease( const xActiveEvent *pxEvent )
+{
+	portENTER_CRITICAL();
+	{
+		prvEventRelease( pxEvent );
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The task of a group.  It takes one event at a time from the first object,
+ * in priority order, that has one, and blocks on xReady when none has.
+ * Posting gives xReady after the event is queued, so an event is never left
+ * waiting while the task blocks.
+ */
+static void prvActiveGroupTask( void *pvParameters )
+{
+xActiveGroup *pxGroup = ( xActiveGroup * ) pvParameters;
+xActiveObject *pxObject;
+const xActiveEvent *pxEvent;
+
+	for( pxObject = pxGroup->pxObjects; pxObject != NULL; pxObject = pxObject->pxNext )
+	{
+		pxObject->pxHandler( pxObject, &xActiveEntryEvent );
+	}
+
+	for( ;; )
+	{
+		for( pxObject = pxGroup->pxObjects; pxObject != NULL; pxObject = pxObject->pxNext )
+		{
+			if( xQueueReceive( pxObject->xQueue, &pxEvent, 0 ) == pdPASS )
+			{
+				break;
+			}
+		}
+
+		if( pxObject != NULL )
+		{
+			pxObject->pxHandler( pxObject, pxEvent );
+			vActiveEventRelease( pxEvent );
+		}
+		else
+		{
+			xSemaphoreTake( pxGroup->xReady, portMAX_DELAY );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xActiveObjectCreate( xActiveObject *pxObject, xActiveGroup *pxGroup, pdACTIVE_HANDLER pxInitial, unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxPriority )
+{
+xActiveObject **ppxLink;
+signed portBASE_TYPE xReturn = pdFAIL;
+
+	if( pxGroup->xReady == NULL )
+	{
+		vSemaphoreCreateBinary( pxGroup->xReady );
+		if( pxGroup->xReady == NULL )
+		{
+			return pdFAIL;
+		}
+
+		/* Created given, take it so the task blocks until an event comes. */
+		xSemaphoreTake( pxGroup->xReady, 0 );
+	}
+
+	pxObject->xQueue = xQueueCreate( uxQueueLength, sizeof( xActiveEvent * ) );
+	if( pxObject->xQueue == NULL )
+	{
+		return pdFAIL;
+	}
+
+	pxObject->pxHandler = pxInitial;
+	pxObject->pxGroup = pxGroup;
+	pxObject->uxPriority = uxPriority;
+
+	portENTER_CRITICAL();
+	{
+		if( uxActiveObjectCount < configACTIVE_MAX_OBJECTS )
+		{
+			pxObject->ucIndex = ( unsigned portCHAR ) uxActiveObjectCount;
+			pxActiveObjects[ uxActiveObjectCount ] = pxObject;
+			uxActiveObjectCount++;
+
+			/* Objects of equal priority keep their creation order. */
+			ppxLink = &( pxGroup->pxObjects );
+			while( ( *ppxLink != NULL ) && ( ( *ppxLink )->uxPriority >= uxPriority ) )
+			{
+				ppxLink = &( ( *ppxLink )->pxNext );
+			}
+			pxObject->pxNext = *ppxLink;
+			*ppxLink = pxObject;
+
+			xReturn = pdPASS;
+		}
+	}
+	portEXIT_CRITICAL();
+
+	if( xReturn != pdPASS )
+	{
+		vQueueDelete( pxObject->xQueue );
+		pxObject->xQueue = NULL;
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xActiveGroupStart( xActiveGroup *pxGroup, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, unsigned portBASE_TYPE uxPriority )
+{
+	if( pxGroup->xReady == NULL )
+	{
+		/* No object was added. */
+		return pdFAIL;
+	}
+
+	return xTaskCreate( prvActiveGroupTask, pcName, usStackDepth, ( void * ) pxGroup, uxPriority, &( pxGroup->xTask ) );
+}
+/*-----------------------------------------------------------*/
+
+void vActiveTransition( xActiveObject *pxObject, pdACTIVE_HANDLER pxNewState )
+{
+	pxObject->pxHandler( pxObject, &xActiveExitEvent );
+	pxObject->pxHandler = pxNewState;
+	pxNewState( pxObject, &xActiveEntryEvent );
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xActivePost( xActiveObject *pxObject, const xActiveEvent *pxEvent, portTickType xTicksToWait )
+{
+signed portBASE_TYPE xReturn;
+
+	portENTER_CRITICAL();
+	{
+		prvEventReference( pxEvent );
+	}
+	portEXIT_CRITICAL();
+
+	xReturn = xQueueSend( pxObject->xQueue, &pxEvent, xTicksToWait );
+	if( xReturn == pdPASS )
+	{
+		xSemaphoreGive( pxObject->pxGroup->xReady );
+	}
+	else
+	{
+		vActiveEventRelease( pxEvent );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xActivePostFromISR( xActiveObject *pxObject, const xActiveEvent *pxEvent, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+signed portBASE_TYPE xReturn;
+
+	prvEventReference( pxEvent );
+
+	xReturn = xQueueSendFromISR( pxObject->xQueue, &pxEvent, pxHigherPriorityTaskWoken );
+	if( xReturn == pdPASS )
+	{
+		xSemaphoreGiveFromISR( pxObject->pxGroup->xReady, pxHigherPriorityTaskWoken );
+	}
+	else
+	{
+		prvEventRelease( pxEvent );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vActiveSubscribe( xActiveObject *pxObject, unsigned portCHAR ucSignal )
+{
+	if( ucSignal < configACTIVE_MAX_SIGNALS )
+	{
+		portENTER_CRITICAL();
+		{
+			usActiveSubscribers[ ucSignal ] |= ( unsigned portSHORT ) ( 1U << pxObject->ucIndex );
+		}
+		portEXIT_CRITICAL();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vActiveUnsubscribe( xActiveObject *pxObject, unsigned portCHAR ucSignal )
+{
+	if( ucSignal < configACTIVE_MAX_SIGNALS )
+	{
+		portENTER_CRITICAL();
+		{
+			usActiveSubscribers[ ucSignal ] &= ( unsigned portSHORT ) ~( 1U << pxObject->ucIndex );
+		}
+		portEXIT_CRITICAL();
+	}
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxActivePublish( const xActiveEvent *pxEvent )
+{
+unsigned portSHORT usSubscribers = 0;
+unsigned portBASE_TYPE uxIndex, uxPosted = 0;
+
+	/* Hold a reference of our own, so a subscriber that handles the event
+	before it is posted to the others can not recycle it. */
+	portENTER_CRITICAL();
+	{
+		prvEventReference( pxEvent );
+		if( pxEvent->ucSignal < configACTIVE_MAX_SIGNALS )
+		{
+			usSubscribers = usActiveSubscribers[ pxEvent->ucSignal ];
+		}
+	}
+	portEXIT_CRITICAL();
+
+	for( uxIndex = 0; usSubscribers != 0; uxIndex++, usSubscribers >>= 1 )
+	{
+		if( ( usSubscribers & 1U ) && ( xActivePost( pxActiveObjects[ uxIndex ], pxEvent, 0 ) == pdPASS ) )
+		{
+			uxPosted++;
+		}
+	}
+
+	vActiveEventRelease( pxEvent );
+
+	return uxPosted;
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxActivePublishFromISR( const xActiveEvent *pxEvent, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+unsigned portSHORT usSubscribers = 0;
+unsigned portBASE_TYPE uxIndex, uxPosted = 0;
+
+	prvEventReference( pxEvent );
+	if( pxEvent->ucSignal < configACTIVE_MAX_SIGNALS )
+	{
+		usSubscribers = usActiveSubscribers[ pxEvent->ucSignal ];
+	}
+
+	for( uxIndex = 0; usSubscribers != 0; uxIndex++, usSubscribers >>= 1 )
+	{
+		if( ( usSubscribers & 1U ) && ( xActivePostFromISR( pxActiveObjects[ uxIndex ], pxEvent, pxHigherPriorityTaskWoken ) == pdPASS ) )
+		{
+			uxPosted++;
+		}
+	}
+
+	prvEventRelease( pxEvent );
+
+	return uxPosted;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_ACTIVE_OBJECTS */
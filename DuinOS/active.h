@@ -0,0 +1,175 @@
+/*
+	Active objects for DuinOS.
+
+	An active object is an event driven state machine with its own event
+	queue.  Its current state is a handler function, which is called with
+	one event at a time and runs to completion before the next event is
+	looked at.
+
+	+ Events are structures that start with an xActiveEvent, ie:
+
+		typedef struct { xActiveEvent xSuper; unsigned portSHORT usKey; } xKeyEvent;
+
+	  They either live in static storage (their pxPool is NULL) or are taken
+	  from an xEventPool of fixed size blocks.  Pool events are reference
+	  counted and go back to their pool once every object they were posted to
+	  has handled them, so no heap is used once the objects are created.  The
+	  queues only carry pointers to the events.
+
+	+ Several objects can share one task, grouped in an xActiveGroup.  The
+	  group task dispatches the pending events of the object with the highest
+	  uxPriority first, so each group costs one stack however many state
+	  machines it runs.  A group of one is a plain active object.
+
+	+ Objects can post to each other directly, or subscribe to signals below
+	  configACTIVE_MAX_SIGNALS and receive every event published with them.
+
+	Enabled by setting configUSE_ACTIVE_OBJECTS to 1 in FreeRTOSConfig.h.  At
+	most configACTIVE_MAX_OBJECTS (up to 16) objects can exist.
+*/
+
+#ifndef ACTIVE_H
+#define ACTIVE_H
+
+#ifndef INC_FREERTOS_H
+	#error "#include FreeRTOS.h" must appear in source files before "#include active.h"
+#endif
+
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if ( configUSE_ACTIVE_OBJECTS == 1 )
+
+/* Signals every state handler gets when it is entered and left by
+vActiveTransition(), and when the group starts.  Application signals start at
+activeSIG_USER. */
+#define activeSIG_ENTRY		( ( unsigned portCHAR ) 0 )
+#define activeSIG_EXIT		( ( unsigned portCHAR ) 1 )
+#define activeSIG_USER		( ( unsigned portCHAR ) 2 )
+
+struct xEVENT_POOL;
+struct xACTIVE_OBJECT;
+struct xACTIVE_GROUP;
+
+/* Header of every event. */
+typedef struct xACTIVE_EVENT
+{
+	unsigned portCHAR ucSignal;
+	unsigned portCHAR ucReferences;		/* Private, queues holding a pool event. */
+	struct xEVENT_POOL *pxPool;			/* NULL for a static event. */
+} xActiveEvent;
+
+/* Fixed size blocks for the events of one size.  The fields are private
+except uxMinFree, the fewest blocks ever left in the pool. */
+typedef struct xEVENT_POOL
+{
+	void *pvFree;
+	unsigned portBASE_TYPE uxFree;
+	unsigned portBASE_TYPE uxMinFree;
+} xEventPool;
+
+/* A state: handles one event, to completion. */
+typedef void (*pdACTIVE_HANDLER)( struct xACTIVE_OBJECT *pxObject, const xActiveEvent *pxEvent );
+
+/* An active object.  Application objects start with one, the fields are
+private. */
+typedef struct xACTIVE_OBJECT
+{
+	pdACTIVE_HANDLER pxHandler;
+	xQueueHandle xQueue;
+	struct xACTIVE_GROUP *pxGroup;
+	struct xACTIVE_OBJECT *pxNext;		/* In the group, by falling priority. */
+	unsigned portBASE_TYPE uxPriority;
+	unsigned portCHAR ucIndex;			/* Subscriber bit. */
+} xActiveObject;
+
+/* The task a set of objects runs in.  The fields are private. */
+typedef struct xACTIVE_GROUP
+{
+	xActiveObject *pxObjects;
+	xSemaphoreHandle xReady;
+	xTaskHandle xTask;
+} xActiveGroup;
+
+/*
+ * Build a pool from uxBlocks blocks of uxBlockSize bytes at pvBlocks,
+ * usually a static array of the event type.
+ */
+void vEventPoolInitialise( xEventPool *pxPool, void *pvBlocks, size_t uxBlockSize, unsigned portBASE_TYPE uxBlocks );
+
+/*
+ * Take an event from a pool and set its signal.  Returns NULL if the pool is
+ * empty.  The FromISR version must be called with interrupts disabled, as
+ * they are in an ISR.
+ */
+xActiveEvent *pxActiveEventNew( xEventPool *pxPool, unsigned portCHAR ucSignal );
+xActiveEvent *pxActiveEventNewFromISR( xEventPool *pxPool, unsigned portCHAR ucSignal );
+
+/*
+ * Give back an event that was taken from a pool but never posted.  Events
+ * that were posted are recycled by the group tasks.
+ */
+void vActiveEventRelease( const xActiveEvent *pxEvent );
+
+/*
+ * Set up an object in its initial state, with room for uxQueueLength pending
+ * events, and add it to a group.  uxPriority orders the objects of the group.
+ * Call it before xActiveGroupStart(), from setup() or from a task.  The group
+ * must have been zeroed, static storage is.
+ *
+ * Returns pdPASS, or pdFAIL if there is no memory for the queue or
+ * configACTIVE_MAX_OBJECTS objects exist already.
+ */
+signed portBASE_TYPE xActiveObjectCreate( xActiveObject *pxObject, xActiveGroup *pxGroup, pdACTIVE_HANDLER pxInitial, unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxPriority );
+
+/*
+ * Create the task of a group.  It sends activeSIG_ENTRY to the initial
+ * state of each object, then dispatches events until it is deleted.
+ *
+ * Returns pdPASS if the task was created.
+ */
+signed portBASE_TYPE xActiveGroupStart( xActiveGroup *pxGroup, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, unsigned portBASE_TYPE uxPriority );
+
+/*
+ * Change the state of an object from within its handler: the current state
+ * gets activeSIG_EXIT and the new one activeSIG_ENTRY.
+ */
+void vActiveTransition( xActiveObject *pxObject, pdACTIVE_HANDLER pxNewState );
+
+/*
+ * Post an event to an object, waiting up to xTicksToWait for room in its
+ * queue.  The FromISR version sets *pxHigherPriorityTaskWoken to pdTRUE if
+ * the ISR should yield before it returns.
+ *
+ * Returns pdPASS, or errQUEUE_FULL.  A pool event that could not be posted
+ * anywhere goes back to its pool.
+ */
+signed portBASE_TYPE xActivePost( xActiveObject *pxObject, const xActiveEvent *pxEvent, portTickType xTicksToWait );
+signed portBASE_TYPE xActivePostFromISR( xActiveObject *pxObject, const xActiveEvent *pxEvent, signed portBASE_TYPE *pxHigherPriorityTaskWoken );
+
+/*
+ * Subscribe an object to the events published with a signal, or stop.
+ */
+void vActiveSubscribe( xActiveObject *pxObject, unsigned portCHAR ucSignal );
+void vActiveUnsubscribe( xActiveObject *pxObject, unsigned portCHAR ucSignal );
+
+/*
+ * Post an event to every subscriber of its signal, without waiting.
+ *
+ * Returns the number of objects it was posted to.
+ */
+unsigned portBASE_TYPE uxActivePublish( const xActiveEvent *pxEvent );
+unsigned portBASE_TYPE uxActivePublishFromISR( const xActiveEvent *pxEvent, signed portBASE_TYPE *pxHigherPriorityTaskWoken );
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACTIVE_H */
@@ -0,0 +1,310 @@
+/*
+	DuinOS kernel microbenchmarks.
+
+	Measures, in CPU cycles, the cost of the kernel primitives:
+
+	  overhead       two back to back reads of the cycle counter (already
+	                 subtracted from every other result)
+	  switch         taskYIELD() from one task until the other task runs
+	  queue          xQueueSend() to a higher priority task that answers
+	                 through a second queue, until the answer is received
+	  sem_give       xSemaphoreGive() on an empty binary semaphore
+	  sem_take       xSemaphoreTake() on a full binary semaphore
+	  delay_wake     from the tick (TIMER0 overflow) until a task blocked in
+	                 vTaskDelay(1) runs again
+	  list_insert    vListInsert() of an item into the middle of a list of
+	                 BENCH_LIST_ITEMS
+	  list_remove    vListRemove() of that item
+
+	The list figures depend on configUSE_COMPACT_LIST_ITEMS, reported in the
+	second table: build the sketch with it set to 0 and to 1 to compare.
+
+	Timer 1 is taken over as a free running cycle counter (clk/1), so PWM on
+	its pins does not work while the benchmark runs.  Each primitive runs
+	BENCH_ITERATIONS times, and min/avg/max are reported.  min is the figure
+	to compare between kernel versions, max includes ticks and USB interrupts
+	that landed inside a measurement.
+
+	A second CSV table gives the RAM the kernel takes per object with the
+	options of the profile it was built for, so the savings of
+	configUSE_PROGMEM_TASK_NAMES show by comparing the Teensy (where it is on)
+	with the Teensy++ (where it is off):
+
+	  progmem_task_names  the option, 0 or 1
+	  compact_list_items  the option, 0 or 1
+	  tcb_bytes           one task control block, without its stack
+	  task_name_bytes     the part of it that holds the name
+
+	The results are written as CSV lines, ended by a line with "end":
+
+	  - to GPIOR0, one character at a time, for the simavr runner in
+	    DuinOS/bench/simavr_bench.c, and
+	  - to Serial, repeated every few seconds, on real hardware.
+*/
+
+#include <stdio.h>
+#include "DuinOS/queue.h"
+#include "DuinOS/semphr.h"
+#include "DuinOS/list.h"
+
+#define BENCH_ITERATIONS	100
+
+#define BENCH_OVERHEAD		0
+#define BENCH_SWITCH		1
+#define BENCH_QUEUE			2
+#define BENCH_SEM_GIVE		3
+#define BENCH_SEM_TAKE		4
+#define BENCH_DELAY_WAKE	5
+#define BENCH_LIST_INSERT	6
+#define BENCH_LIST_REMOVE	7
+#define BENCH_COUNT			8
+
+//Items already in the list the list benchmarks insert into:
+#define BENCH_LIST_ITEMS	8
+
+//Cycles between two TIMER0 overflows: 256 counts at clk/64.
+#define TICK_CYCLES			16384
+
+//The phase lock below needs the default tick.
+#if configTICK_SOURCE != portTICK_SOURCE_TIMER0
+	#error kernel_bench needs configTICK_SOURCE portTICK_SOURCE_TIMER0
+#endif
+
+#if defined(__AVR_AT90USB1286__)
+	#define BENCH_MCU "at90usb1286"
+#elif defined(__AVR_AT90USB646__)
+	#define BENCH_MCU "at90usb646"
+#elif defined(__AVR_ATmega32U4__)
+	#define BENCH_MCU "atmega32u4"
+#elif defined(__AVR_AT90USB162__)
+	#define BENCH_MCU "at90usb162"
+#else
+	#define BENCH_MCU "unknown"
+#endif
+
+static const char *benchNames[BENCH_COUNT] = {
+	"overhead", "switch", "queue", "sem_give", "sem_take", "delay_wake",
+	"list_insert", "list_remove"
+};
+
+static uint16_t benchMin[BENCH_COUNT];
+static uint16_t benchMax[BENCH_COUNT];
+static uint32_t benchSum[BENCH_COUNT];
+static uint16_t benchCount[BENCH_COUNT];
+
+static uint16_t overhead;
+
+static volatile uint16_t switchStart;
+static volatile uint8_t switchArmed;
+
+static xQueueHandle pingQueue, pongQueue;
+static xSemaphoreHandle semaphore;
+
+static xList benchList;
+static xListItem benchItems[BENCH_LIST_ITEMS + 1];
+
+static void sample(uint8_t bench, uint16_t cycles)
+{
+	cycles = (cycles > overhead) ? cycles - overhead : 0;
+
+	if (!benchCount[bench] || cycles < benchMin[bench])
+		benchMin[bench] = cycles;
+	if (cycles > benchMax[bench])
+		benchMax[bench] = cycles;
+	benchSum[bench] += cycles;
+	benchCount[bench]++;
+}
+
+static void emit(const char *s)
+{
+	Serial.print(s);
+	while (*s)
+		GPIOR0 = *s++;
+}
+
+//The other half of the context switch benchmark, runs at the same priority
+//as the main loop:
+taskLoop(switchPartner)
+{
+	uint16_t now = TCNT1;
+
+	if (switchArmed)
+		sample(BENCH_SWITCH, now - switchStart);
+	taskYIELD();
+}
+
+//Answers every ping with a pong, at a higher priority than the main loop:
+taskLoop(queuePartner)
+{
+	uint8_t value;
+
+	if (xQueueReceive(pingQueue, &value, portMAX_DELAY) == pdPASS)
+		xQueueSend(pongQueue, &value, 0);
+}
+
+static void benchOverhead()
+{
+	uint16_t start, now;
+
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		start = TCNT1;
+		now = TCNT1;
+		sample(BENCH_OVERHEAD, now - start);
+	}
+	overhead = benchMin[BENCH_OVERHEAD];
+}
+
+static void benchSwitch()
+{
+	switchArmed = 0;
+	createTaskLoop(switchPartner, NORMAL_PRIORITY);
+	//Let the partner reach its first yield:
+	taskYIELD();
+	switchArmed = 1;
+
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		switchStart = TCNT1;
+		taskYIELD();
+	}
+	vTaskDelete(switchPartner);
+}
+
+static void benchQueue()
+{
+	uint16_t start;
+	uint8_t value = 0;
+
+	createTaskLoop(queuePartner, HIGH_PRIORITY);
+
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		start = TCNT1;
+		xQueueSend(pingQueue, &value, 0);
+		xQueueReceive(pongQueue, &value, 0);
+		sample(BENCH_QUEUE, TCNT1 - start);
+	}
+	vTaskDelete(queuePartner);
+}
+
+static void benchSemaphore()
+{
+	uint16_t start;
+
+	xSemaphoreTake(semaphore, 0);
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		start = TCNT1;
+		xSemaphoreGive(semaphore);
+		sample(BENCH_SEM_GIVE, TCNT1 - start);
+
+		start = TCNT1;
+		xSemaphoreTake(semaphore, 0);
+		sample(BENCH_SEM_TAKE, TCNT1 - start);
+	}
+}
+
+static void benchListInsertRemove()
+{
+	xListItem *item = &benchItems[BENCH_LIST_ITEMS];
+	uint16_t start;
+
+	vListInitialise(&benchList);
+	for (uint8_t i = 0; i < BENCH_LIST_ITEMS; i++) {
+		vListInitialiseItem(&benchItems[i]);
+		listSET_LIST_ITEM_VALUE(&benchItems[i], i * 2);
+		vListInsert(&benchList, &benchItems[i]);
+	}
+	//An odd value, so the insert walks half the list:
+	vListInitialiseItem(item);
+	listSET_LIST_ITEM_VALUE(item, BENCH_LIST_ITEMS - 1);
+
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		start = TCNT1;
+		vListInsert(&benchList, item);
+		sample(BENCH_LIST_INSERT, TCNT1 - start);
+
+		start = TCNT1;
+		vListRemove(item);
+		sample(BENCH_LIST_REMOVE, TCNT1 - start);
+	}
+}
+
+static void benchDelayWake()
+{
+	uint8_t sreg = SREG;
+
+	//Phase lock Timer 1 to Timer 0: both count CPU cycles and 65536 is a
+	//multiple of TICK_CYCLES, so from here on every tick happens when the low
+	//14 bits of TCNT1 are zero (give or take the few cycles of this loop).
+	cli();
+	TIFR0 = (1<<TOV0);
+	while (!(TIFR0 & (1<<TOV0))) ;
+	TCNT1 = 0;
+	SREG = sreg;
+
+	for (uint8_t i = 0; i < BENCH_ITERATIONS; i++) {
+		vTaskDelay(1);
+		//Not a difference of two reads, so no read overhead to remove:
+		sample(BENCH_DELAY_WAKE, (TCNT1 & (TICK_CYCLES - 1)) + overhead);
+	}
+}
+
+static void report()
+{
+	char line[64];
+
+	emit("mcu,primitive,iterations,min,avg,max\r\n");
+	for (uint8_t i = 0; i < BENCH_COUNT; i++) {
+		sprintf(line, "%s,%s,%u,%u,%lu,%u\r\n", BENCH_MCU, benchNames[i],
+		        benchCount[i], benchMin[i],
+		        benchCount[i] ? benchSum[i] / benchCount[i] : 0UL, benchMax[i]);
+		emit(line);
+	}
+	emit("mcu,setting,value\r\n");
+	sprintf(line, "%s,progmem_task_names,%u\r\n", BENCH_MCU, (unsigned) configUSE_PROGMEM_TASK_NAMES);
+	emit(line);
+	sprintf(line, "%s,compact_list_items,%u\r\n", BENCH_MCU, (unsigned) configUSE_COMPACT_LIST_ITEMS);
+	emit(line);
+#if configUSE_STATIC_ALLOCATION
+	//xStaticTask is checked to be the size of the TCB in tasks.c:
+	sprintf(line, "%s,tcb_bytes,%u\r\n", BENCH_MCU, (unsigned) sizeof(xStaticTask));
+	emit(line);
+#endif
+#if configUSE_PROGMEM_TASK_NAMES
+	sprintf(line, "%s,task_name_bytes,%u\r\n", BENCH_MCU, (unsigned) sizeof(const void *));
+#else
+	sprintf(line, "%s,task_name_bytes,%u\r\n", BENCH_MCU, (unsigned) configMAX_TASK_NAME_LEN);
+#endif
+	emit(line);
+	emit("end\r\n");
+}
+
+void setup()
+{
+	//Timer 1 as a free running cycle counter:
+	TCCR1A = 0;
+	TCCR1B = (1<<CS10);
+
+	pingQueue = xQueueCreate(1, sizeof(uint8_t));
+	pongQueue = xQueueCreate(1, sizeof(uint8_t));
+	vSemaphoreCreateBinary(semaphore);
+
+	initMainLoopPriority(NORMAL_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	static uint8_t done;
+
+	if (!done) {
+		benchOverhead();
+		benchSwitch();
+		benchQueue();
+		benchSemaphore();
+		benchListInsertRemove();
+		benchDelayWake();
+		done = 1;
+	}
+	report();
+	delay(3000);
+}
@@ -0,0 +1,100 @@
+/*
+	simavr runner for the DuinOS kernel benchmarks.
+
+	Loads a kernel_bench firmware (see kernel_bench/kernel_bench.pde), runs it
+	until it reports "end" and copies the CSV results it writes to GPIOR0 to
+	stdout, so the cycle counts can be collected by scripts:
+
+	  simavr_bench atmega32u4 16000000 kernel_bench.elf > results.csv
+
+	The simavr build used must include the core for the MCU given.  There is
+	no USB host in the simulation; the PLL lock the core waits for in
+	usb_init() is faked so the firmware starts.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+
+//Data space addresses, identical on the ATmega32U4 and AT90USB646/1286:
+#define GPIOR0_ADDR		0x3e
+#define PLLCSR_ADDR		0x49
+#define PLOCK_BIT		0
+
+//Give up if the firmware has not finished after this many simulated seconds:
+#define TIMEOUT_SECONDS	60
+
+static char line[128];
+static size_t lineLength;
+static int finished;
+
+static void gpior0Write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	(void) avr; (void) addr; (void) param;
+
+	if (v == '\r')
+		return;
+	if (v != '\n') {
+		if (lineLength < sizeof(line) - 1)
+			line[lineLength++] = v;
+		return;
+	}
+	line[lineLength] = 0;
+	lineLength = 0;
+	if (!strcmp(line, "end"))
+		finished = 1;
+	else
+		puts(line);
+}
+
+static uint8_t pllcsrRead(avr_t *avr, avr_io_addr_t addr, void *param)
+{
+	(void) param;
+
+	return avr->data[addr] | (1 << PLOCK_BIT);
+}
+
+int main(int argc, char *argv[])
+{
+	elf_firmware_t firmware;
+	avr_t *avr;
+	int state;
+
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s <mcu> <f_cpu> <firmware.elf>\n", argv[0]);
+		return 2;
+	}
+
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[3], &firmware) != 0) {
+		fprintf(stderr, "%s: can't load %s\n", argv[0], argv[3]);
+		return 2;
+	}
+	avr = avr_make_mcu_by_name(argv[1]);
+	if (!avr) {
+		fprintf(stderr, "%s: simavr has no core for %s\n", argv[0], argv[1]);
+		return 2;
+	}
+	avr_init(avr);
+	firmware.frequency = strtoul(argv[2], NULL, 0);
+	avr_load_firmware(avr, &firmware);
+
+	avr_register_io_write(avr, GPIOR0_ADDR, gpior0Write, NULL);
+	avr_register_io_read(avr, PLLCSR_ADDR, pllcsrRead, NULL);
+
+	do {
+		state = avr_run(avr);
+	} while (!finished && state != cpu_Done && state != cpu_Crashed &&
+	         avr->cycle < (avr_cycle_count_t)avr->frequency * TIMEOUT_SECONDS);
+
+	if (!finished) {
+		fprintf(stderr, "%s: firmware stopped before reporting (state %d, %llu cycles)\n",
+		        argv[0], state, (unsigned long long)avr->cycle);
+		return 1;
+	}
+	return 0;
+}
@@ -14,10 +14,56 @@ void duinos_main_Task(void *pvParameters)
 
 void startDuinOS(void) 
 {
-	xTaskCreate(duinos_main_Task, (signed portCHAR *) "main", 
+#if configUSE_PEND_CALL_TASK
+	//Runs the interrupt work deferred with xPendFunctionCallFromISR():
+	xPendCallInitialise();
+#endif
+	xTaskCreate(duinos_main_Task, tskTASK_NAME("main"), 
 	            configMINIMAL_STACK_SIZE, NULL, mainLoopPriority, NULL);
 	vTaskStartScheduler();
 
 	//Will not get here unless a task calls vTaskEndScheduler():
 	for (;;);
 }
+
+void dumpPeriodicTask(Print &out, const char *name, const xPeriodicStats *stats)
+{
+	xPeriodicStats copy;
+
+	vPeriodicStatsGet(stats, &copy);
+	out.print(name);
+	out.print(": ");
+	out.print(copy.ulReleases);
+	out.print(" runs, ");
+	out.print(copy.ulOverruns);
+	out.print(" overruns, jitter max ");
+	out.print(portTICK_FRACTION_TO_US(copy.ulJitterMax));
+	out.print(" us, execution last ");
+	out.print(portTICK_FRACTION_TO_US(copy.ulExecutionLast));
+	out.print(" us, max ");
+	out.print(portTICK_FRACTION_TO_US(copy.ulExecutionMax));
+	out.println(" us");
+}
+
+#if configUSE_CPU_LOAD
+void dumpCpuLoad(Print &out)
+{
+	out.print("CPU load: ");
+	out.print((unsigned int)cpuLoad1s());
+	out.print("% 1s, ");
+	out.print((unsigned int)cpuLoad10s());
+	out.print("% 10s, ");
+	out.print((unsigned int)cpuLoad60s());
+	out.println("% 60s");
+}
+#endif
+
+#if configUSE_CRITICAL_SECTION_TRACKING
+void dumpCriticalSections(Print &out)
+{
+	out.print("Longest interrupts off: ");
+	out.print(ulPortCriticalMaxCycles());
+	out.print(" cycles, at 0x");
+	out.println((long)ulPortCriticalMaxSite(), HEX);
+}
+#endif
@@ -5,7 +5,12 @@
 extern "C"{
 #endif
 
+#ifndef DUINOS_POSIX_PORT
 void startDuinOS(void) __attribute__ ((naked));
+#else
+//##A naked function can not call others safely on the host:
+void startDuinOS(void);
+#endif
 
 extern unsigned portBASE_TYPE mainLoopPriority;
 
@@ -0,0 +1,100 @@
+/*
+	Scoped guards for C++ code.
+
+	A guard holds something off from its declaration to the end of the
+	enclosing block, whichever way the block is left:
+
+		uint8_t usb_serial_class::available(void)
+		{
+			InterruptLock lock;
+			...
+			return n;
+		}
+
+	+ InterruptLock disables interrupts and puts the interrupt flag back as
+	  it was, so it nests and can be used in ISRs.  It costs an in, a cli and
+	  an out, with SREG kept in a register.
+
+	+ TaskInterruptLock is a plain cli and sei, for the outermost section of
+	  code that always runs with interrupts enabled (task code, not ISRs or
+	  callbacks that may be called from them).
+
+	+ TickLock masks the tick alone, so the USB and every other interrupt keep
+	  running.  It keeps out millis(), the tick hook and time slicing but is
+	  no kernel critical section, see portTICK_MASK() in portmacro.h.
+
+	+ SchedulerLock suspends the scheduler, interrupts stay enabled.  Nests
+	  at the cost of a call on each side.
+
+	The interrupt-off guards go through the critical section tracking of
+	configUSE_CRITICAL_SECTION_TRACKING.  Keep them short, and never block in
+	any of them.  C code uses portINTERRUPTS_OFF() and portINTERRUPTS_RESTORE()
+	instead.
+*/
+
+#ifndef GUARD_H
+#define GUARD_H
+
+#ifndef INC_FREERTOS_H
+	#error "#include FreeRTOS.h" must appear in source files before "#include guard.h"
+#endif
+
+#include "task.h"
+
+#ifdef __cplusplus
+
+#define guardINLINE		inline __attribute__ ( ( always_inline ) )
+
+class InterruptLock
+{
+public:
+	guardINLINE InterruptLock() { portINTERRUPTS_OFF( uxSaved ); }
+	guardINLINE ~InterruptLock() { portINTERRUPTS_RESTORE( uxSaved ); }
+
+private:
+	InterruptLock( const InterruptLock & );
+	InterruptLock &operator=( const InterruptLock & );
+
+	unsigned portBASE_TYPE uxSaved;
+};
+
+class TaskInterruptLock
+{
+public:
+	guardINLINE TaskInterruptLock() { portINTERRUPTS_OFF_FROM_TASK(); }
+	guardINLINE ~TaskInterruptLock() { portINTERRUPTS_ON_FROM_TASK(); }
+
+private:
+	TaskInterruptLock( const TaskInterruptLock & );
+	TaskInterruptLock &operator=( const TaskInterruptLock & );
+};
+
+class TickLock
+{
+public:
+	guardINLINE TickLock() { portTICK_MASK( uxSaved ); }
+	guardINLINE ~TickLock() { portTICK_UNMASK( uxSaved ); }
+
+private:
+	TickLock( const TickLock & );
+	TickLock &operator=( const TickLock & );
+
+	unsigned portBASE_TYPE uxSaved;
+};
+
+class SchedulerLock
+{
+public:
+	guardINLINE SchedulerLock() { vTaskSuspendAll(); }
+	guardINLINE ~SchedulerLock() { xTaskResumeAll(); }
+
+private:
+	SchedulerLock( const SchedulerLock & );
+	SchedulerLock &operator=( const SchedulerLock & );
+};
+
+#undef guardINLINE
+
+#endif
+
+#endif /* GUARD_H */
@@ -68,6 +68,13 @@
  * effectively a two way link between the object containing the list item and
  * the list item itself.
  *
+ * When configUSE_COMPACT_LIST_ITEMS is 1 the pointer back to the owner is
+ * dropped.  A list item is always embedded in its owner, so the owner is
+ * found by subtracting the offset of the item within the owning structure.
+ * Every item placed in a given list must then sit at the same offset within
+ * its owner, and the owner is read through the ..._AT() access macros, which
+ * take that offset.
+ *
  *
  * \page ListIntroduction List Implementation
  * \ingroup FreeRTOSIntro
@@ -94,7 +101,9 @@ struct xLIST_ITEM
 	portTickType xItemValue;				/*< The value being listed.  In most cases this is used to sort the list in descending order. */
 	volatile struct xLIST_ITEM * pxNext;	/*< Pointer to the next xListItem in the list. */
 	volatile struct xLIST_ITEM * pxPrevious;/*< Pointer to the previous xListItem in the list. */
-	void * pvOwner;							/*< Pointer to the object (normally a TCB) that contains the list item.  There is therefore a two way link between the object containing the list item and the list item itself. */
+	#if ( configUSE_COMPACT_LIST_ITEMS == 0 )
+		void * pvOwner;						/*< Pointer to the object (normally a TCB) that contains the list item.  There is therefore a two way link between the object containing the list item and the list item itself. */
+	#endif
 	void * pvContainer;						/*< Pointer to the list in which this list item is placed (if any). */
 };
 typedef struct xLIST_ITEM xListItem;		/* For some reason lint wants this as two separate definitions. */
@@ -124,7 +133,25 @@ typedef struct xLIST
  * \page listSET_LIST_ITEM_OWNER listSET_LIST_ITEM_OWNER
  * \ingroup LinkedList
  */
-#define listSET_LIST_ITEM_OWNER( pxListItem, pxOwner )		( pxListItem )->pvOwner = ( void * ) pxOwner
+#if ( configUSE_COMPACT_LIST_ITEMS == 0 )
+	#define listSET_LIST_ITEM_OWNER( pxListItem, pxOwner )		( pxListItem )->pvOwner = ( void * ) pxOwner
+#else
+	#define listSET_LIST_ITEM_OWNER( pxListItem, pxOwner )
+#endif
+
+/*
+ * Access macro to get the owner of a list item.  xOffset is the offset of the
+ * list item within its owner, and is only used when configUSE_COMPACT_LIST_ITEMS
+ * is 1 - it is normally obtained with offsetof().
+ *
+ * \page listGET_LIST_ITEM_OWNER listGET_LIST_ITEM_OWNER
+ * \ingroup LinkedList
+ */
+#if ( configUSE_COMPACT_LIST_ITEMS == 0 )
+	#define listGET_LIST_ITEM_OWNER( pxListItem, xOffset )	( ( pxListItem )->pvOwner )
+#else
+	#define listGET_LIST_ITEM_OWNER( pxListItem, xOffset )	( ( void * ) ( ( ( unsigned portCHAR * ) ( pxListItem ) ) - ( xOffset ) ) )
+#endif
 
 /*
  * Access macro to set the value of the list item.  In most cases the value is
@@ -178,7 +205,7 @@ typedef struct xLIST
  * \page listGET_OWNER_OF_NEXT_ENTRY listGET_OWNER_OF_NEXT_ENTRY
  * \ingroup LinkedList
  */
-#define listGET_OWNER_OF_NEXT_ENTRY( pxTCB, pxList )									\
+#define listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, pxList, xOffset )						\
 {																						\
 xList * const pxConstList = pxList;														\
 	/* Increment the index to the next item and return the item, ensuring */			\
@@ -188,9 +215,13 @@ xList * const pxConstList = pxList;														\
 	{																					\
 		( pxConstList )->pxIndex = ( pxConstList )->pxIndex->pxNext;					\
 	}																					\
-	pxTCB = ( pxConstList )->pxIndex->pvOwner;											\
+	pxTCB = listGET_LIST_ITEM_OWNER( ( pxConstList )->pxIndex, xOffset );				\
 }
 
+#if ( configUSE_COMPACT_LIST_ITEMS == 0 )
+	#define listGET_OWNER_OF_NEXT_ENTRY( pxTCB, pxList )	listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, pxList, 0 )
+#endif
+
 
 /*
  * Access function to obtain the owner of the first entry in a list.  Lists
@@ -208,7 +239,11 @@ xList * const pxConstList = pxList;														\
  * \page listGET_OWNER_OF_HEAD_ENTRY listGET_OWNER_OF_HEAD_ENTRY
  * \ingroup LinkedList
  */
-#define listGET_OWNER_OF_HEAD_ENTRY( pxList )  ( ( pxList->uxNumberOfItems != ( unsigned portBASE_TYPE ) 0 ) ? ( (&( pxList->xListEnd ))->pxNext->pvOwner ) : ( NULL ) )
+#define listGET_OWNER_OF_HEAD_ENTRY_AT( pxList, xOffset )  ( ( pxList->uxNumberOfItems != ( unsigned portBASE_TYPE ) 0 ) ? ( listGET_LIST_ITEM_OWNER( (&( pxList->xListEnd ))->pxNext, xOffset ) ) : ( NULL ) )
+
+#if ( configUSE_COMPACT_LIST_ITEMS == 0 )
+	#define listGET_OWNER_OF_HEAD_ENTRY( pxList )	listGET_OWNER_OF_HEAD_ENTRY_AT( pxList, 0 )
+#endif
 
 /*
  * Check to see if a list item is within a list.  The list item maintains a
@@ -222,6 +257,12 @@ xList * const pxConstList = pxList;														\
  */
 #define listIS_CONTAINED_WITHIN( pxList, pxListItem ) ( ( pxListItem )->pvContainer == ( void * ) pxList )
 
+/*
+ * Access macro to return the list a list item is in, or NULL if it is not in
+ * a list.
+ */
+#define listLIST_ITEM_CONTAINER( pxListItem ) ( ( pxListItem )->pvContainer )
+
 /*
  * Must be called before a list is used!  This initialises all the members
  * of the list structure and inserts the xListEnd item into the list as a
@@ -0,0 +1,99 @@
+/*
+	Deferred interrupt processing for DuinOS, see pendcall.h.
+*/
+
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "pendcall.h"
+
+#if ( configUSE_PEND_CALL_TASK == 1 )
+
+typedef struct xPEND_CALL
+{
+	pdPEND_FUNCTION pxFunction;
+	void *pvParameter;
+} xPendCall;
+
+/* Only set once the handler task exists, so an ISR never queues calls that
+nobody will run. */
+static xQueueHandle xPendCallQueue = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvPendCallTask( void *pvParameters )
+{
+xQueueHandle xQueue = ( xQueueHandle ) pvParameters;
+xPendCall xCall;
+
+	for( ;; )
+	{
+		if( xQueueReceive( xQueue, &xCall, portMAX_DELAY ) == pdPASS )
+		{
+			xCall.pxFunction( xCall.pvParameter );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xPendCallInitialise( void )
+{
+xQueueHandle xQueue;
+
+	if( xPendCallQueue != NULL )
+	{
+		return pdPASS;
+	}
+
+	xQueue = xQueueCreate( configPEND_CALL_QUEUE_LENGTH, sizeof( xPendCall ) );
+	if( xQueue == NULL )
+	{
+		return pdFAIL;
+	}
+
+	/* The task gets the queue as its parameter, the queue is only published
+	to the ISRs once the task exists. */
+	if( xTaskCreate( prvPendCallTask, tskTASK_NAME( "PEND" ), configPEND_CALL_STACK_SIZE, ( void * ) xQueue, configPEND_CALL_TASK_PRIORITY, NULL ) != pdPASS )
+	{
+		vQueueDelete( xQueue );
+		return pdFAIL;
+	}
+	xPendCallQueue = xQueue;
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xPendFunctionCall( pdPEND_FUNCTION pxFunction, void *pvParameter, portTickType xTicksToWait )
+{
+xPendCall xCall;
+
+	if( xPendCallQueue == NULL )
+	{
+		return pdFAIL;
+	}
+
+	xCall.pxFunction = pxFunction;
+	xCall.pvParameter = pvParameter;
+
+	return xQueueSend( xPendCallQueue, &xCall, xTicksToWait );
+}
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE xPendFunctionCallFromISR( pdPEND_FUNCTION pxFunction, void *pvParameter, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+xPendCall xCall;
+
+	if( ( xPendCallQueue == NULL ) || ( xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED ) )
+	{
+		return pdFAIL;
+	}
+
+	xCall.pxFunction = pxFunction;
+	xCall.pvParameter = pvParameter;
+
+	return xQueueSendFromISR( xPendCallQueue, &xCall, pxHigherPriorityTaskWoken );
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+	Deferred interrupt processing for DuinOS.
+
+	An ISR can hand a function and a parameter to a dedicated handler task
+	instead of doing the work itself.  The ISR then only costs a queue post,
+	and the work runs in task context, with interrupts enabled, at
+	configPEND_CALL_TASK_PRIORITY.
+
+	Enabled by setting configUSE_PEND_CALL_TASK to 1 in FreeRTOSConfig.h.
+	The handler task and its queue are created by xPendCallInitialise(), which
+	startDuinOS() calls.
+*/
+
+#ifndef PEND_CALL_H
+#define PEND_CALL_H
+
+#ifndef INC_FREERTOS_H
+	#error "#include FreeRTOS.h" must appear in source files before "#include pendcall.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Function run by the handler task. */
+typedef void (*pdPEND_FUNCTION)( void *pvParameter );
+
+#if ( configUSE_PEND_CALL_TASK == 1 )
+
+/*
+ * Create the handler task and its queue, if not done yet.  Call it from
+ * setup() or from a task, never from an ISR.
+ *
+ * Returns pdPASS if the handler task exists.
+ */
+signed portBASE_TYPE xPendCallInitialise( void );
+
+/*
+ * Queue a call to pxFunction( pvParameter ) from a task, waiting up to
+ * xTicksToWait for room in the queue.
+ *
+ * Returns pdPASS if the call was queued.
+ */
+signed portBASE_TYPE xPendFunctionCall( pdPEND_FUNCTION pxFunction, void *pvParameter, portTickType xTicksToWait );
+
+/*
+ * Queue a call to pxFunction( pvParameter ) from an ISR.  As with the other
+ * FromISR functions, *pxHigherPriorityTaskWoken is set to pdTRUE if the ISR
+ * should yield before it returns.
+ *
+ * Returns pdFAIL if the call could not be queued: the queue is full, or the
+ * scheduler has not started yet so the handler task can not run.  The ISR
+ * must then do the work itself.
+ */
+signed portBASE_TYPE xPendFunctionCallFromISR( pdPEND_FUNCTION pxFunction, void *pvParameter, signed portBASE_TYPE *pxHigherPriorityTaskWoken );
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEND_CALL_H */
@@ -0,0 +1,101 @@
+/*
+	Statistics for periodic tasks, see periodic.h.
+*/
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "periodic.h"
+
+/*-----------------------------------------------------------*/
+
+void vPeriodicTaskRelease( xPeriodicStats *pxStats, portTickType xReleaseTick )
+{
+portTickType xNow;
+unsigned portSHORT usFraction;
+unsigned portLONG ulJitter;
+
+	/* The tick count and the position within the tick must be read
+	together. */
+	portENTER_CRITICAL();
+	{
+		xNow = xTaskGetTickCount();
+		usFraction = usPortTickFraction();
+	}
+	portEXIT_CRITICAL();
+
+	ulJitter = ( unsigned portLONG ) ( portTickType ) ( xNow - xReleaseTick ) * portTICK_FRACTIONS + usFraction;
+
+	portENTER_CRITICAL();
+	{
+		pxStats->ulReleases++;
+		if( ulJitter > pxStats->ulJitterMax )
+		{
+			pxStats->ulJitterMax = ulJitter;
+		}
+	}
+	portEXIT_CRITICAL();
+
+	/* Only used by this task. */
+	pxStats->xStartTick = xNow;
+	pxStats->usStartFraction = usFraction;
+}
+/*-----------------------------------------------------------*/
+
+void vPeriodicTaskComplete( xPeriodicStats *pxStats, portTickType xReleaseTick, portTickType xPeriod )
+{
+portTickType xNow;
+unsigned portSHORT usFraction;
+unsigned portLONG ulExecution;
+
+	portENTER_CRITICAL();
+	{
+		xNow = xTaskGetTickCount();
+		usFraction = usPortTickFraction();
+	}
+	portEXIT_CRITICAL();
+
+	/* A fraction may run past the end of its tick when the tick was
+	pending, so both ends are turned into tick fractions before they are
+	subtracted. */
+	ulExecution = ( ( unsigned portLONG ) ( portTickType ) ( xNow - pxStats->xStartTick ) * portTICK_FRACTIONS + usFraction ) - pxStats->usStartFraction;
+
+	portENTER_CRITICAL();
+	{
+		pxStats->ulExecutionLast = ulExecution;
+		if( ulExecution > pxStats->ulExecutionMax )
+		{
+			pxStats->ulExecutionMax = ulExecution;
+		}
+
+		/* The next run was due at xReleaseTick + xPeriod.  vTaskDelayUntil()
+		will not block for it, so the task catches up with back to back
+		runs, which the jitter of those runs shows. */
+		if( ( portTickType ) ( xNow - xReleaseTick ) >= xPeriod )
+		{
+			pxStats->ulOverruns++;
+		}
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vPeriodicStatsGet( const xPeriodicStats *pxStats, xPeriodicStats *pxCopy )
+{
+	portENTER_CRITICAL();
+	memcpy( ( void * ) pxCopy, ( const void * ) pxStats, sizeof( xPeriodicStats ) );
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vPeriodicStatsReset( xPeriodicStats *pxStats )
+{
+	portENTER_CRITICAL();
+	pxStats->ulReleases = 0;
+	pxStats->ulOverruns = 0;
+	pxStats->ulJitterMax = 0;
+	pxStats->ulExecutionLast = 0;
+	pxStats->ulExecutionMax = 0;
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
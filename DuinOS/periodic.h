@@ -0,0 +1,68 @@
+/*
+	Statistics for periodic tasks.
+
+	A task created with the periodicTaskLoop() macro of DuinOS.h runs its
+	body once per period, released by vTaskDelayUntil().  Around every run
+	it records:
+
+	+ The release jitter: how late the body started, from the tick the task
+	  was due at.
+	+ The execution time of the body, including any time it was preempted.
+	+ The overruns: runs that had not finished when the next one was due.
+
+	Times are in fractions of a tick (see portTICK_FRACTIONS in portmacro.h,
+	counts of the tick timer on the AVR), portTICK_FRACTION_TO_US() converts
+	them to microseconds.
+*/
+
+#ifndef PERIODIC_H
+#define PERIODIC_H
+
+#ifndef INC_FREERTOS_H
+	#error "#include FreeRTOS.h" must appear in source files before "#include periodic.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct xPERIODIC_STATS
+{
+	unsigned portLONG ulReleases;		/*< Number of times the body was run. */
+	unsigned portLONG ulOverruns;		/*< Number of runs that did not complete within their period. */
+	unsigned portLONG ulJitterMax;		/*< Longest release jitter, in tick fractions. */
+	unsigned portLONG ulExecutionLast;	/*< Execution time of the last run, in tick fractions. */
+	unsigned portLONG ulExecutionMax;	/*< Longest execution time, in tick fractions. */
+
+	portTickType xStartTick;			/*< Private, when the current run started. */
+	unsigned portSHORT usStartFraction;
+} xPeriodicStats;
+
+/*
+ * Called by the task right after it was released for the run due at
+ * xReleaseTick, before the body runs.
+ */
+void vPeriodicTaskRelease( xPeriodicStats *pxStats, portTickType xReleaseTick );
+
+/*
+ * Called by the task after the body of the run due at xReleaseTick
+ * returned.  xPeriod is the period in ticks.
+ */
+void vPeriodicTaskComplete( xPeriodicStats *pxStats, portTickType xReleaseTick, portTickType xPeriod );
+
+/*
+ * Copy the statistics of a task, atomically, so that they can be read from
+ * any other task.
+ */
+void vPeriodicStatsGet( const xPeriodicStats *pxStats, xPeriodicStats *pxCopy );
+
+/*
+ * Clear the statistics of a task, for instance once it reached steady state.
+ */
+void vPeriodicStatsReset( xPeriodicStats *pxStats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERIODIC_H */
@@ -80,6 +80,39 @@ Changes from V2.6.0
 #define portCLOCK_PRESCALER						( (unsigned portLONG) 64 )
 #define portCOMPARE_MATCH_A_INTERRUPT_ENABLE	( (unsigned portCHAR)(1 << OCIE1A) )
 
+/* Registers of the tick timer chosen by configTICK_SOURCE, see portmacro.h.
+portTICK_PENDING() is the flag of the interrupt that ends the tick. */
+#if configTICK_SOURCE == portTICK_SOURCE_TIMER0
+	#define portTICK_vect						TIMER0_OVF_vect
+	#define portTICK_COUNT()					( ( unsigned portSHORT ) TCNT0 )
+	#define portTICK_PENDING()					( TIFR0 & ( 1 << TOV0 ) )
+#elif configTICK_SOURCE == portTICK_SOURCE_TIMER1
+	#define portTICK_vect						TIMER1_COMPA_vect
+	#define portTICK_COUNT()					( TCNT1 )
+	#define portTICK_PENDING()					( TIFR1 & ( 1 << OCF1A ) )
+#elif configTICK_SOURCE == portTICK_SOURCE_TIMER3
+	#ifndef TCCR3A
+		#error portTICK_SOURCE_TIMER3 needs a part with a Timer 3
+	#endif
+	#define portTICK_vect						TIMER3_COMPA_vect
+	#define portTICK_COUNT()					( TCNT3 )
+	#define portTICK_PENDING()					( TIFR3 & ( 1 << OCF3A ) )
+#elif configTICK_SOURCE == portTICK_SOURCE_TIMER4
+	#ifndef WGM42
+		#error portTICK_SOURCE_TIMER4 needs a part with a 16 bit Timer 4
+	#endif
+	#define portTICK_vect						TIMER4_COMPA_vect
+	#define portTICK_COUNT()					( TCNT4 )
+	#define portTICK_PENDING()					( TIFR4 & ( 1 << OCF4A ) )
+#else
+	#error Unknown configTICK_SOURCE
+#endif
+
+/* An end of tick that is pending while the count reads this close to the top
+happened after the count was read.  The count and the flag are a few cycles
+apart, which is a few counts at clk/1 but never more than one otherwise. */
+#define portTICK_READ_MARGIN					( ( portTICK_PRESCALER == 1UL ) ? 8U : 1U )
+
 /*-----------------------------------------------------------*/
 
 /* We require the address of the pxCurrentTCB variable, but don't want to know
@@ -206,6 +239,15 @@ extern volatile tskTCB * volatile pxCurrentTCB;
 static void prvSetupTimerInterrupt( void );
 /*-----------------------------------------------------------*/
 
+#if configUSE_CRITICAL_SECTION_TRACKING == 1
+	/*
+	 * Drop the timing of the running task's critical section when it yields
+	 * from within it.
+	 */
+	static void prvCriticalDiscard( void );
+#endif
+/*-----------------------------------------------------------*/
+
 /* 
  * See header file for description. 
  */
@@ -356,6 +398,9 @@ void vPortYield( void ) __attribute__ ( ( naked ) );
 void vPortYield( void )
 {
 	portSAVE_CONTEXT();
+	#if configUSE_CRITICAL_SECTION_TRACKING == 1
+		prvCriticalDiscard();
+	#endif
 	vTaskSwitchContext();
 	portRESTORE_CONTEXT();
 
@@ -383,14 +428,64 @@ void vPortYieldFromTick( void )
 /*-----------------------------------------------------------*/
 
 /*
- * Setup timer 1 compare match A to generate a tick interrupt.
+ * Setup timer 1 compare match A to generate a tick interrupt, or the tick
+ * source chosen with configTICK_SOURCE for Arduino.
  */
 static void prvSetupTimerInterrupt( void )
 {
   unsigned portLONG ulCompareMatch;
 
   // timer 0 will be used in Arduino, and it's setup by the Arduino lib
-#ifndef FREERTOS_ARDUINO
+#ifdef FREERTOS_ARDUINO
+  #if configTICK_SOURCE != portTICK_SOURCE_TIMER0
+	unsigned portCHAR ucClockSelect;
+
+	/* Clock select bits of the prescaler, the same on every 16 bit timer. */
+	switch( portTICK_PRESCALER )
+	{
+		case 1UL:	ucClockSelect = 1; break;
+		case 8UL:	ucClockSelect = 2; break;
+		case 64UL:	ucClockSelect = 3; break;
+		case 256UL:	ucClockSelect = 4; break;
+		default:	ucClockSelect = 5; break;
+	}
+
+	ulCompareMatch = portTICK_FRACTIONS - ( unsigned portLONG ) 1;
+
+	/* Timer 0 keeps running for the PWM on OC0B, but no longer interrupts. */
+	TIMSK0 &= ~( 1 << TOIE0 );
+
+	/* CTC mode with TOP in OCRnA, taking the timer over from the PWM setup of
+	init().  Interrupts are disabled before this is called. */
+	#if configTICK_SOURCE == portTICK_SOURCE_TIMER1
+		TCCR1B = 0;
+		TCCR1A = 0;
+		TCNT1 = 0;
+		OCR1A = ( unsigned portSHORT ) ulCompareMatch;
+		TIFR1 = ( 1 << OCF1A );
+		TIMSK1 = ( 1 << OCIE1A );
+		TCCR1B = ( 1 << WGM12 ) | ucClockSelect;
+	#elif configTICK_SOURCE == portTICK_SOURCE_TIMER3
+		TCCR3B = 0;
+		TCCR3A = 0;
+		TCNT3 = 0;
+		OCR3A = ( unsigned portSHORT ) ulCompareMatch;
+		TIFR3 = ( 1 << OCF3A );
+		TIMSK3 = ( 1 << OCIE3A );
+		TCCR3B = ( 1 << WGM32 ) | ucClockSelect;
+	#else
+		TCCR4B = 0;
+		TCCR4A = 0;
+		TCNT4 = 0;
+		OCR4A = ( unsigned portSHORT ) ulCompareMatch;
+		TIFR4 = ( 1 << OCF4A );
+		TIMSK4 = ( 1 << OCIE4A );
+		TCCR4B = ( 1 << WGM42 ) | ucClockSelect;
+	#endif
+  #else
+	( void ) ulCompareMatch;
+  #endif
+#else
 
 	/* Using 16bit timer 1 to generate the tick.  Correct fuses must be
 	selected for the configCPU_CLOCK_HZ clock. */
@@ -439,7 +534,7 @@ static void prvSetupTimerInterrupt( void )
   	//void TIMER1_OVF_vect( void ) __attribute__ ( ( signal, naked ) );
   	//void TIMER1_OVF_vect( void )
 	
-  	ISR(TIMER0_OVF_vect, ISR_NAKED)
+  	ISR(portTICK_vect, ISR_NAKED)
   	{
 	  	vPortYieldFromTick();
   		asm volatile ( "reti" );
@@ -451,8 +546,8 @@ static void prvSetupTimerInterrupt( void )
   	 * tick count.  We don't need to switch context, this can only be done by
   	 * manual calls to taskYIELD();
   	 */
-  	void TIMER0_OVF_vect( void ) __attribute__ ( ( signal ) );
-  	void TIMER0_OVF_vect( void )
+  	void portTICK_vect( void ) __attribute__ ( ( signal ) );
+  	void portTICK_vect( void )
   	{
       arduino_increment_millis();
 		  vTaskIncrementTick();
@@ -488,3 +583,126 @@ static void prvSetupTimerInterrupt( void )
   	}
   #endif
 #endif
+/*-----------------------------------------------------------*/
+
+#ifdef FREERTOS_ARDUINO
+  /*
+   * Position within the current tick, in counts of the tick timer.  Called
+   * with interrupts disabled.  If the interrupt that ends the tick is pending
+   * the tick count has not moved on yet, so the fraction goes past the end of
+   * the tick instead.
+   */
+  unsigned portSHORT usPortTickFraction( void )
+  {
+  unsigned portSHORT usCount = portTICK_COUNT();
+
+  	if( portTICK_PENDING() && ( usCount < ( unsigned portSHORT ) ( portTICK_FRACTIONS - portTICK_READ_MARGIN ) ) )
+  	{
+  		usCount += ( unsigned portSHORT ) portTICK_FRACTIONS;
+  	}
+
+  	return usCount;
+  }
+
+  /* Ticks counted by arduino_increment_millis(). */
+  extern volatile unsigned long timer0_overflow_count;
+
+  /*
+   * Tick timer time, in counts.  Called with interrupts disabled, so a tick
+   * that happened since they were disabled is still pending.
+   */
+  unsigned portLONG ulPortGetTimestamp( void )
+  {
+  unsigned portLONG ulTicks = timer0_overflow_count;
+
+  	return ( ulTicks * portTICK_FRACTIONS ) + usPortTickFraction();
+  }
+#endif
+/*-----------------------------------------------------------*/
+
+#if configUSE_CRITICAL_SECTION_TRACKING == 1
+
+  #ifndef FREERTOS_ARDUINO
+  	#error configUSE_CRITICAL_SECTION_TRACKING needs the tick of FREERTOS_ARDUINO as its time base
+  #endif
+
+  /* One count of the tick timer is this many CPU cycles. */
+  #define portCRITICAL_CYCLES_PER_COUNT	portTICK_PRESCALER
+
+  /* Sections are timed with ulPortGetTimestamp().  Those longer than one
+  tick are under-reported, as further overflows are lost while interrupts are
+  off. */
+
+  static volatile unsigned portCHAR ucCriticalOpen = pdFALSE;
+  static volatile unsigned portLONG ulCriticalStart = 0;
+  static void * volatile pvCriticalSite = NULL;
+  static volatile unsigned portLONG ulCriticalMax = 0;
+  static void * volatile pvCriticalMaxSite = NULL;
+
+  static void prvCriticalDiscard( void )
+  {
+  	ucCriticalOpen = pdFALSE;
+  }
+
+  /*
+   * Called right after interrupts were switched off by a critical section.
+   */
+  void vPortCriticalEntered( void *pvSite )
+  {
+  	ulCriticalStart = ulPortGetTimestamp();
+  	pvCriticalSite = pvSite;
+  	ucCriticalOpen = pdTRUE;
+  }
+
+  /*
+   * Called right before interrupts are switched back on.
+   */
+  void vPortCriticalLeaving( void )
+  {
+  unsigned portLONG ulDuration;
+
+  	if( ucCriticalOpen == pdTRUE )
+  	{
+  		ucCriticalOpen = pdFALSE;
+  		ulDuration = ulPortGetTimestamp() - ulCriticalStart;
+  		if( ulDuration > ulCriticalMax )
+  		{
+  			ulCriticalMax = ulDuration;
+  			pvCriticalMaxSite = pvCriticalSite;
+  		}
+  	}
+  }
+
+  unsigned portLONG ulPortCriticalMaxCycles( void )
+  {
+  unsigned portLONG ulReturn;
+
+  	portENTER_CRITICAL();
+  	ulReturn = ulCriticalMax;
+  	portEXIT_CRITICAL();
+
+  	return ulReturn * portCRITICAL_CYCLES_PER_COUNT;
+  }
+
+  unsigned portLONG ulPortCriticalMaxSite( void )
+  {
+  void *pvReturn;
+
+  	portENTER_CRITICAL();
+  	pvReturn = pvCriticalMaxSite;
+  	portEXIT_CRITICAL();
+
+  	/* Code addresses are word addresses on the AVR, the map file and
+  	avr-objdump show byte addresses. */
+  	return ( ( unsigned portLONG ) ( unsigned portSHORT ) pvReturn ) << 1;
+  }
+
+  void vPortCriticalReset( void )
+  {
+  	portENTER_CRITICAL();
+  	ulCriticalMax = 0;
+  	pvCriticalMaxSite = NULL;
+  	portEXIT_CRITICAL();
+  }
+
+#endif
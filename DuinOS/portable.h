@@ -291,6 +291,10 @@
 	#include "../../Source/portable/IAR/78K0R/portmacro.h"
 #endif
 	
+#ifdef DUINOS_POSIX_PORT
+	#include "posix/portmacro.h"
+#endif
+
 /* Catch all to ensure portmacro.h is included in the build.  Newer demos
 have the path as part of the project options, rather than as relative from
 the project location.  If portENTER_CRITICAL() has not been defined then
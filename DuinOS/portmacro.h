@@ -88,24 +88,225 @@ extern "C" {
 /*-----------------------------------------------------------*/	
 
 /* Critical section management. */
-#define portENTER_CRITICAL()		asm volatile ( "in		__tmp_reg__, __SREG__" :: );	\
-									asm volatile ( "cli" :: );								\
-									asm volatile ( "push	__tmp_reg__" :: )
 
-#define portEXIT_CRITICAL()			asm volatile ( "pop		__tmp_reg__" :: );				\
-									asm volatile ( "out		__SREG__, __tmp_reg__" :: )
+/* The global interrupt enable of SREG. */
+#define portSREG_I					( ( unsigned portCHAR ) 0x80 )
+
+#if configUSE_CRITICAL_SECTION_TRACKING == 1
+
+	/* Instrumented critical sections, see vPortCriticalEntered() in port.c.
+	Only the sections that actually switch interrupts off are timed, nested
+	ones and those inside ISRs run with interrupts already disabled.  The
+	address of the section is taken from a local label, as
+	__builtin_return_address() is not reliable on the AVR. */
+	extern void vPortCriticalEntered( void *pvSite );
+	extern void vPortCriticalLeaving( void );
+
+	/* Longest interrupt-off section seen so far, in CPU cycles (with the
+	resolution of the tick timer, see portTICK_PRESCALER), and the flash byte
+	address it starts at. */
+	extern unsigned portLONG ulPortCriticalMaxCycles( void );
+	extern unsigned portLONG ulPortCriticalMaxSite( void );
+	extern void vPortCriticalReset( void );
+
+	#define portCRITICAL_ENTERED( ucSREG )	{																\
+												__label__ xCriticalSite;									\
+												xCriticalSite:												\
+												if( ( ucSREG ) & portSREG_I )								\
+												{															\
+													vPortCriticalEntered( &&xCriticalSite );				\
+												}															\
+											}
+
+	#define portCRITICAL_LEAVING( ucSREG )	{																\
+												if( ( ucSREG ) & portSREG_I )								\
+												{															\
+													vPortCriticalLeaving();									\
+												}															\
+											}
+
+	#define portENTER_CRITICAL()		{																	\
+											unsigned portCHAR ucCriticalSREG;								\
+											asm volatile ( "in		%0, __SREG__	\n\t"						\
+														   "cli						\n\t"						\
+														   "push	%0				\n\t"						\
+														   : "=r" ( ucCriticalSREG ) );						\
+											portCRITICAL_ENTERED( ucCriticalSREG );							\
+										}
+
+	#define portEXIT_CRITICAL()			{																	\
+											unsigned portCHAR ucCriticalSREG;								\
+											asm volatile ( "pop		%0" : "=r" ( ucCriticalSREG ) );			\
+											portCRITICAL_LEAVING( ucCriticalSREG );							\
+											asm volatile ( "out		__SREG__, %0" :: "r" ( ucCriticalSREG ) );	\
+										}
+
+#else
+
+	/* Hooks for the interrupt-off sections outside the kernel, such as the
+	cli() sections in the USB code.  ucSREG is the SREG saved before cli(). */
+	#define portCRITICAL_ENTERED( ucSREG )
+	#define portCRITICAL_LEAVING( ucSREG )
+
+	#define portENTER_CRITICAL()		asm volatile ( "in		__tmp_reg__, __SREG__" :: );	\
+										asm volatile ( "cli" :: );								\
+										asm volatile ( "push	__tmp_reg__" :: )
+
+	#define portEXIT_CRITICAL()			asm volatile ( "pop		__tmp_reg__" :: );				\
+										asm volatile ( "out		__SREG__, __tmp_reg__" :: )
+
+#endif
 
 #define portDISABLE_INTERRUPTS()	asm volatile ( "cli" :: );
 #define portENABLE_INTERRUPTS()		asm volatile ( "sei" :: );
+
+/* Interrupt-off sections outside the kernel, for the core and the guards of
+DuinOS/guard.h.  Unlike portENTER_CRITICAL() they keep the saved SREG in a
+variable of the caller, usually a register, rather than on the stack, and they
+go through the tracking hooks above.
+
+portINTERRUPTS_OFF() saves SREG into ucSREG and disables interrupts,
+portINTERRUPTS_RESTORE() puts the interrupt flag back as it was, so they nest
+and can be used in ISRs.  portINTERRUPTS_OFF_FROM_TASK() and
+portINTERRUPTS_ON_FROM_TASK() are a plain cli and sei, for the outermost
+section of code that always runs with interrupts enabled. */
+#define portINTERRUPTS_OFF( ucSREG )	{																	\
+											asm volatile ( "in		%0, __SREG__	\n\t"						\
+														   "cli						\n\t"						\
+														   : "=r" ( ucSREG ) :: "memory" );					\
+											portCRITICAL_ENTERED( ucSREG );									\
+										}
+
+#define portINTERRUPTS_RESTORE( ucSREG )	{																\
+											portCRITICAL_LEAVING( ucSREG );									\
+											asm volatile ( "out		__SREG__, %0" :: "r" ( ucSREG ) : "memory" );	\
+										}
+
+#define portINTERRUPTS_OFF_FROM_TASK()	{																	\
+											asm volatile ( "cli" ::: "memory" );							\
+											portCRITICAL_ENTERED( portSREG_I );								\
+										}
+
+#define portINTERRUPTS_ON_FROM_TASK()	{																	\
+											portCRITICAL_LEAVING( portSREG_I );								\
+											asm volatile ( "sei" ::: "memory" );							\
+										}
 /*-----------------------------------------------------------*/
 
 /* Architecture specifics. */
 #define portSTACK_GROWTH			( -1 )
-#define portTICK_RATE_MS			( ( portTickType ) 1000 / configTICK_RATE_HZ )		
 #define portBYTE_ALIGNMENT			1
 #define portNOP()					asm volatile ( "nop" );
 /*-----------------------------------------------------------*/
 
+/* Tick sources, for configTICK_SOURCE in FreeRTOSConfig.h.
+
+portTICK_SOURCE_TIMER0 is the overflow of the Timer 0 the Arduino core runs
+for millis() and the PWM on OC0B.  It is F_CPU / 16384, 976.5625 Hz at 16 MHz,
+whatever configTICK_RATE_HZ says.
+
+The other sources run a 16 bit timer in CTC mode at exactly configTICK_RATE_HZ.
+The prescaler is the smallest one that fits the tick into 32768 counts, so
+F_CPU / configTICK_RATE_HZ must be a multiple of it for the rate to be exact.
+The timer is then lost to analogWrite().  Timer 3 does not exist on the 168
+and 328, Timer 4 is only a 16 bit timer on the 1280. */
+#define portTICK_SOURCE_TIMER0		0
+#define portTICK_SOURCE_TIMER1		1
+#define portTICK_SOURCE_TIMER3		3
+#define portTICK_SOURCE_TIMER4		4
+
+#ifndef configTICK_SOURCE
+	#define configTICK_SOURCE		portTICK_SOURCE_TIMER0
+#endif
+
+/* The interrupt enable of the tick. */
+#if !defined( FREERTOS_ARDUINO ) || ( configTICK_SOURCE == portTICK_SOURCE_TIMER1 )
+	#define portTICK_ENABLE_REGISTER	TIMSK1
+	#define portTICK_ENABLE_BIT			( ( unsigned portCHAR ) ( 1 << OCIE1A ) )
+#elif configTICK_SOURCE == portTICK_SOURCE_TIMER0
+	#define portTICK_ENABLE_REGISTER	TIMSK0
+	#define portTICK_ENABLE_BIT			( ( unsigned portCHAR ) ( 1 << TOIE0 ) )
+#elif configTICK_SOURCE == portTICK_SOURCE_TIMER3
+	#define portTICK_ENABLE_REGISTER	TIMSK3
+	#define portTICK_ENABLE_BIT			( ( unsigned portCHAR ) ( 1 << OCIE3A ) )
+#else
+	#define portTICK_ENABLE_REGISTER	TIMSK4
+	#define portTICK_ENABLE_BIT			( ( unsigned portCHAR ) ( 1 << OCIE4A ) )
+#endif
+
+/* Hold off the tick alone, leaving every other interrupt (USB, serial) enabled.
+This keeps out the tick ISR (millis(), the tick hook, delays expiring and time
+slicing) without adding to the interrupt latency of the rest.  It is no kernel
+critical section: other ISRs can still use the FromISR API and wake a task.
+ucSaved receives the previous enable for portTICK_UNMASK(), so they nest.  A
+tick that falls due meanwhile runs at portTICK_UNMASK(), later ones are lost,
+so keep the sections well under a tick. */
+#define portTICK_MASK( ucSaved )		{																	\
+											unsigned portCHAR ucTickMaskSREG;								\
+											asm volatile ( "in		%0, __SREG__	\n\t"						\
+														   "cli						\n\t"						\
+														   : "=r" ( ucTickMaskSREG ) :: "memory" );			\
+											( ucSaved ) = portTICK_ENABLE_REGISTER & portTICK_ENABLE_BIT;	\
+											portTICK_ENABLE_REGISTER &= ( unsigned portCHAR ) ~portTICK_ENABLE_BIT;	\
+											asm volatile ( "out		__SREG__, %0" :: "r" ( ucTickMaskSREG ) : "memory" );	\
+										}
+
+#define portTICK_UNMASK( ucSaved )		{																	\
+											if( ( ucSaved ) != 0 )											\
+											{																\
+												unsigned portCHAR ucTickMaskSREG;							\
+												asm volatile ( "in		%0, __SREG__	\n\t"					\
+															   "cli						\n\t"					\
+															   : "=r" ( ucTickMaskSREG ) :: "memory" );		\
+												portTICK_ENABLE_REGISTER |= portTICK_ENABLE_BIT;			\
+												asm volatile ( "out		__SREG__, %0" :: "r" ( ucTickMaskSREG ) : "memory" );	\
+											}																\
+										}
+
+#if configTICK_SOURCE == portTICK_SOURCE_TIMER0
+
+	#define portTICK_PRESCALER		( ( unsigned portLONG ) 64 )
+	#define portTICK_FRACTIONS		( ( unsigned portLONG ) 256 )
+
+	/* ms * F_CPU / 16384000, rounded up so any delay lasts at least a tick,
+	without overflowing for delays up to an hour. */
+	#define portMS_TO_TICKS( ulMs )	( ( portTickType ) ( ( ( unsigned portLONG ) ( ulMs ) * ( configCPU_CLOCK_HZ / 16000UL ) + 1023UL ) / 1024UL ) )
+
+#else
+
+	#define portTICK_CYCLES			( configCPU_CLOCK_HZ / ( unsigned portLONG ) configTICK_RATE_HZ )
+	#define portTICK_PRESCALER		( ( portTICK_CYCLES <= 32768UL ) ? 1UL :			\
+									( ( portTICK_CYCLES <= 262144UL ) ? 8UL :			\
+									( ( portTICK_CYCLES <= 2097152UL ) ? 64UL :			\
+									( ( portTICK_CYCLES <= 8388608UL ) ? 256UL : 1024UL ) ) ) )
+	#define portTICK_FRACTIONS		( portTICK_CYCLES / portTICK_PRESCALER )
+
+	/* Rounded up, as above. */
+	#define portMS_TO_TICKS( ulMs )	( ( portTickType ) ( ( ( unsigned portLONG ) ( ulMs ) * configTICK_RATE_HZ + 999UL ) / 1000UL ) )
+
+#endif
+
+/* Milliseconds per tick, from the period the tick timer really runs at.  Being
+an integer it is only approximate unless a tick is a whole number of
+milliseconds: 1 for the 1.024 ms of Timer 0 at 16 MHz, and never less than 1
+so it can be divided by.  Convert with portMS_TO_TICKS() instead, which is
+exact to the tick. */
+#define portTICK_RATE_MS		( ( portTickType ) ( ( portTICK_PRESCALER * portTICK_FRACTIONS * 1000UL >= configCPU_CLOCK_HZ ) ?									( portTICK_PRESCALER * portTICK_FRACTIONS * 1000UL ) / configCPU_CLOCK_HZ : 1UL ) )
+
+/* Sub-tick time.  The fraction of the current tick is the count of the tick
+timer, which counts every portTICK_PRESCALER CPU cycles up to
+portTICK_FRACTIONS - 1.  Call usPortTickFraction() with interrupts disabled,
+it returns up to twice portTICK_FRACTIONS - 1 if a tick is pending. */
+#define portTICK_FRACTION_TO_US( ulFractions )	( ( ( unsigned portLONG ) ( ulFractions ) * portTICK_PRESCALER ) / ( configCPU_CLOCK_HZ / 1000000UL ) )
+extern unsigned portSHORT usPortTickFraction( void );
+
+/* Free running time in the same units, from the tick count kept with
+millis() in the core, so it keeps going while the scheduler is suspended.
+Call it with interrupts disabled.  Wraps after about 4.7 hours at 16 MHz with
+Timer 0, after 268 seconds with a CTC tick at clk/1. */
+extern unsigned portLONG ulPortGetTimestamp( void );
+/*-----------------------------------------------------------*/
+
 /* Kernel utilities. */
 extern void vPortYield( void ) __attribute__ ( ( naked ) );
 #define portYIELD()					vPortYield()
@@ -0,0 +1,105 @@
+/*
+	Host replacement for the core's WProgram.h, used by the POSIX port.
+
+	Only the parts of the Arduino API that DuinOS itself and simple test
+	sketches rely on are provided: the timing functions, the sketch entry
+	points and a Print class.  The hardware (pins, USB serial) does not exist
+	on the host, Serial only prints to stdout.
+*/
+
+#ifndef WProgram_h
+#define WProgram_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+void setup(void);
+void loop(void);
+
+static inline unsigned long micros(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long)t.tv_sec * 1000000UL + t.tv_nsec / 1000;
+}
+
+static inline unsigned long millis(void)
+{
+	return micros() / 1000;
+}
+
+static inline void wiring_delay(unsigned long ms)
+{
+	struct timespec t;
+
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
+	while (nanosleep(&t, &t) != 0) ;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __cplusplus
+
+#define DEC 10
+#define HEX 16
+
+//Same interface as the core's Print, for the reports DuinOS prints:
+class Print
+{
+  public:
+    virtual void write(uint8_t c) = 0;
+    void print(const char *s) { while (*s) write(*s++); }
+    void print(char c) { write(c); }
+    void print(long n, int base = DEC)
+    {
+      if (base == DEC && n < 0) {
+        write('-');
+        n = -n;
+      }
+      print((unsigned long)n, base);
+    }
+    void print(unsigned long n, int base = DEC)
+    {
+      char buf[8 * sizeof(long) + 1];
+      char *p = &buf[sizeof(buf) - 1];
+
+      *p = 0;
+      do {
+        *--p = "0123456789ABCDEF"[n % base];
+        n /= base;
+      } while (n);
+      print(p);
+    }
+    void print(int n, int base = DEC) { print((long)n, base); }
+    void print(unsigned int n, int base = DEC) { print((unsigned long)n, base); }
+    void println(void) { print("\r\n"); }
+    template <class T> void println(T x) { print(x); println(); }
+    template <class T> void println(T x, int base) { print(x, base); println(); }
+};
+
+//Unbuffered, as stdio can not be used by preemptible tasks:
+class StdoutPrint : public Print
+{
+  public:
+    void write(uint8_t c) { if (::write(1, &c, 1) < 0) return; }
+};
+
+static StdoutPrint Serial;
+
+#endif
+
+//##DiunOS is include here, because it's part of the core:
+#include "DuinOS.h"
+
+#endif
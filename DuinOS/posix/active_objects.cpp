@@ -0,0 +1,216 @@
+/*
+	Active object test for the POSIX port.
+
+	Two groups run three objects.  The first group holds a high and a low
+	priority worker, the second a toggler that moves between two states.
+	The main loop checks, in turn, that:
+
+	  - the higher priority object of a group is always dispatched first,
+	  - every entry signal is paired with an exit signal across the
+	    toggler's transitions,
+	  - the event pool is full again after publishing more events than the
+	    queues can hold.
+
+	It prints the counts and exits with 1 if anything was out of place.
+*/
+
+#include <stdio.h>
+#include <WProgram.h>
+#include "DuinOS/active.h"
+
+#define PRIORITY_ROUNDS		50
+#define TRANSITIONS			300
+#define POOL_ROUNDS			10
+
+#define QUEUE_LENGTH		8
+#define POOL_BLOCKS			12
+#define PUBLISHED			20
+
+#define SIG_WORK			(activeSIG_USER + 0)
+#define SIG_TOGGLE			(activeSIG_USER + 1)
+#define SIG_DATA			(activeSIG_USER + 2)
+
+struct DataEvent
+{
+	xActiveEvent super;
+	unsigned long sequence;
+};
+
+static xActiveGroup workers, toggling;
+static xActiveObject high, low, toggler;
+
+static DataEvent poolBlocks[POOL_BLOCKS];
+static xEventPool pool;
+
+static const xActiveEvent workEvent = { SIG_WORK, 0, NULL };
+static const xActiveEvent toggleEvent = { SIG_TOGGLE, 0, NULL };
+
+//Dispatch log of the workers, 'h' or 'l' per event:
+static char dispatched[2 * QUEUE_LENGTH];
+static volatile unsigned dispatchCount;
+
+static volatile unsigned long entries, exits, transitions, dataReceived;
+static volatile unsigned long errors;
+static pdACTIVE_HANDLER insideState;
+static unsigned long overflowed;
+
+static void worker(xActiveObject *object, const xActiveEvent *event)
+{
+	if (event->ucSignal == SIG_WORK) {
+		if (dispatchCount < sizeof(dispatched))
+			dispatched[dispatchCount] = (object == &high) ? 'h' : 'l';
+		dispatchCount++;
+	}
+	else if (event->ucSignal == SIG_DATA)
+		dataReceived++;
+}
+
+static void toggleOff(xActiveObject *object, const xActiveEvent *event);
+
+//Entry and exit must alternate, each exit leaving the state last entered:
+static void trackState(pdACTIVE_HANDLER state, const xActiveEvent *event)
+{
+	if (event->ucSignal == activeSIG_ENTRY) {
+		if (insideState != NULL)
+			errors++;
+		insideState = state;
+		entries++;
+	}
+	else if (event->ucSignal == activeSIG_EXIT) {
+		if (insideState != state)
+			errors++;
+		insideState = NULL;
+		exits++;
+	}
+}
+
+static void toggleOn(xActiveObject *object, const xActiveEvent *event)
+{
+	trackState(toggleOn, event);
+	if (event->ucSignal == SIG_TOGGLE) {
+		transitions++;
+		vActiveTransition(object, toggleOff);
+	}
+	else if (event->ucSignal == SIG_DATA)
+		dataReceived++;
+}
+
+static void toggleOff(xActiveObject *object, const xActiveEvent *event)
+{
+	trackState(toggleOff, event);
+	if (event->ucSignal == SIG_TOGGLE) {
+		transitions++;
+		vActiveTransition(object, toggleOn);
+	}
+	else if (event->ucSignal == SIG_DATA)
+		dataReceived++;
+}
+
+static void checkPriority(void)
+{
+	unsigned i;
+
+	for (unsigned round = 0; round < PRIORITY_ROUNDS; round++) {
+		dispatchCount = 0;
+
+		//The main loop outranks the groups, so both queues fill before any
+		//dispatch.  The low priority object is posted to first:
+		for (i = 0; i < QUEUE_LENGTH; i++)
+			xActivePost(&low, &workEvent, 0);
+		for (i = 0; i < QUEUE_LENGTH; i++)
+			xActivePost(&high, &workEvent, 0);
+
+		delay(20);
+
+		if (dispatchCount != 2 * QUEUE_LENGTH)
+			errors++;
+		for (i = 0; i < 2 * QUEUE_LENGTH; i++)
+			if (dispatched[i] != (i < QUEUE_LENGTH ? 'h' : 'l'))
+				errors++;
+	}
+}
+
+static void checkTransitions(void)
+{
+	for (unsigned i = 0; i < TRANSITIONS; i++)
+		xActivePost(&toggler, &toggleEvent, portMAX_DELAY);
+	delay(20);
+
+	//The initial state was entered when the group started:
+	if (transitions != TRANSITIONS || exits != TRANSITIONS || entries != TRANSITIONS + 1)
+		errors++;
+}
+
+static void checkPool(void)
+{
+	xActiveEvent *taken[POOL_BLOCKS + 1];
+	unsigned count;
+
+	vActiveSubscribe(&high, SIG_DATA);
+	vActiveSubscribe(&low, SIG_DATA);
+	vActiveSubscribe(&toggler, SIG_DATA);
+
+	for (unsigned round = 0; round < POOL_ROUNDS; round++) {
+		//More events than the queues hold, some reach no subscriber at all:
+		for (unsigned i = 0; i < PUBLISHED; i++) {
+			DataEvent *event = (DataEvent *)pxActiveEventNew(&pool, SIG_DATA);
+
+			if (event == NULL) {
+				overflowed++;
+				continue;
+			}
+			event->sequence = i;
+			if (uxActivePublish(&event->super) < 3)
+				overflowed++;
+		}
+
+		delay(20);
+
+		//Every block must be back, each can be taken once:
+		for (count = 0; count <= POOL_BLOCKS; count++) {
+			taken[count] = pxActiveEventNew(&pool, SIG_DATA);
+			if (taken[count] == NULL)
+				break;
+		}
+		if (count != POOL_BLOCKS)
+			errors++;
+		while (count)
+			vActiveEventRelease(taken[--count]);
+	}
+	if (!overflowed)
+		errors++;
+}
+
+void setup()
+{
+	vEventPoolInitialise(&pool, poolBlocks, sizeof(DataEvent), POOL_BLOCKS);
+
+	xActiveObjectCreate(&high, &workers, worker, QUEUE_LENGTH, 2);
+	xActiveObjectCreate(&low, &workers, worker, QUEUE_LENGTH, 1);
+	xActiveObjectCreate(&toggler, &toggling, toggleOff, QUEUE_LENGTH, 1);
+
+	xActiveGroupStart(&workers, (const signed portCHAR *)"workers", configMINIMAL_STACK_SIZE, NORMAL_PRIORITY);
+	xActiveGroupStart(&toggling, (const signed portCHAR *)"toggling", configMINIMAL_STACK_SIZE, NORMAL_PRIORITY);
+
+	initMainLoopPriority(HIGH_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	//Let both groups send the initial entry signals:
+	delay(20);
+
+	checkPriority();
+	checkTransitions();
+	checkPool();
+
+	suspendAll();
+	printf("%u priority rounds, %lu transitions (%lu entries, %lu exits), "
+	       "%lu pool events received, %lu overflowed, %lu errors\n",
+	       PRIORITY_ROUNDS, transitions, entries, exits,
+	       dataReceived, overflowed, errors);
+	fflush(stdout);
+	exit(errors ? 1 : 0);
+}
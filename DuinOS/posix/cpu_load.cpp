@@ -0,0 +1,74 @@
+/*
+	CPU load test for the POSIX port.
+
+	A task busy-waits for LIGHT_MS out of every PERIOD_MS for PHASE_MS,
+	then for HEAVY_MS out of every PERIOD_MS.  The main loop checks, each
+	within TOLERANCE percent, that:
+
+	  - the 1 s and 10 s loads read 30% at the end of the first phase,
+	  - they read 70% at the end of the second, a whole 10 s window later,
+	  - the 60 s load reads the average of every second so far.
+
+	It prints the readings and exits with 1 if any is off.
+*/
+
+#include <stdio.h>
+#include <WProgram.h>
+
+#define PERIOD_MS			10
+#define LIGHT_MS			3
+#define HEAVY_MS			7
+#define PHASE_MS			12000
+#define TOLERANCE			5
+
+static volatile unsigned long busyMs = LIGHT_MS;
+static unsigned long errors;
+
+periodicTaskLoop(busy, PERIOD_MS)
+{
+	unsigned long start = micros();
+
+	while (micros() - start < busyMs * 1000UL)
+		;
+}
+
+static unsigned check(unsigned long reading, unsigned long expected)
+{
+	if (reading + TOLERANCE < expected || reading > expected + TOLERANCE)
+		errors++;
+	return reading;
+}
+
+void setup()
+{
+	createTaskLoop(busy, NORMAL_PRIORITY);
+
+	initMainLoopPriority(HIGH_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	unsigned light1s, light10s, light60s, heavy1s, heavy10s, heavy60s;
+	unsigned long expected60s;
+
+	delay(PHASE_MS);
+	light1s = check(cpuLoad1s(), 100 * LIGHT_MS / PERIOD_MS);
+	light10s = check(cpuLoad10s(), 100 * LIGHT_MS / PERIOD_MS);
+	light60s = check(cpuLoad60s(), 100 * LIGHT_MS / PERIOD_MS);
+
+	busyMs = HEAVY_MS;
+	delay(PHASE_MS);
+	heavy1s = check(cpuLoad1s(), 100 * HEAVY_MS / PERIOD_MS);
+	heavy10s = check(cpuLoad10s(), 100 * HEAVY_MS / PERIOD_MS);
+	//Both phases are shorter than 60 s, so it holds all of them:
+	expected60s = (100 * LIGHT_MS / PERIOD_MS + 100 * HEAVY_MS / PERIOD_MS) / 2;
+	heavy60s = check(cpuLoad60s(), expected60s);
+
+	suspendAll();
+	printf("light: %u%%/%u%%/%u%%, heavy: %u%%/%u%%/%u%% (1 s/10 s/60 s), %lu errors\n",
+	       light1s, light10s, light60s, heavy1s, heavy10s, heavy60s, errors);
+	fflush(stdout);
+	exit(errors ? 1 : 0);
+}
@@ -0,0 +1,13 @@
+#include <WProgram.h>
+
+//##Same as the core's main.cpp, without the hardware init(). As on the
+//##target, the sketch starts the scheduler with startDuinOS() from setup():
+int main(void)
+{
+	setup();
+
+	for (;;)
+		loop();
+
+	return 0;
+}
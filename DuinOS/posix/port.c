@@ -0,0 +1,410 @@
+/*
+	POSIX host port for DuinOS.
+
+	This file is the POSIX counterpart of DuinOS/port.c.  It lets the kernel
+	sources run unchanged as a Linux process:
+
+	+ Every task gets a ucontext and a native stack of portPOSIX_STACK_SIZE
+	  bytes.  The stack allocated by the kernel only holds a pointer to that
+	  context, which is what pxTopOfStack points to.
+
+	+ The tick is a SIGALRM raised by an interval timer at configTICK_RATE_HZ.
+	  Disabling interrupts blocks SIGALRM, so critical sections and the
+	  scheduler suspension work exactly as on the target.
+
+	+ Library code that is not reentrant (stdio, malloc) must only be called
+	  from within a critical section or with the scheduler suspended, as a
+	  preempted task could otherwise be interrupted while holding its lock.
+
+	This file follows the FreeRTOS licensing of DuinOS/port.c.
+*/
+
+#ifdef DUINOS_POSIX_PORT
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if configCHECK_FOR_STACK_OVERFLOW > 0
+	#error "The POSIX port does not run tasks on the kernel stacks, so configCHECK_FOR_STACK_OVERFLOW must be 0"
+#endif
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the POSIX port.
+ *----------------------------------------------------------*/
+
+/* Everything the port needs to resume a task.  The kernel sees a pointer to
+this structure as the task's top of stack. */
+typedef struct xPORT_CONTEXT
+{
+	ucontext_t xContext;
+	unsigned portBASE_TYPE uxCriticalNesting;
+	unsigned portBASE_TYPE uxCriticalTickWasEnabled;
+	pdTASK_CODE pxCode;
+	void *pvParameters;
+	void *pvStack;
+} xPortContext;
+
+/* We require the address of the pxCurrentTCB variable, but don't want to know
+any details of its type.  The first member of the TCB is pxTopOfStack, which
+holds the xPortContext pointer of the task. */
+typedef void tskTCB;
+extern volatile tskTCB * volatile pxCurrentTCB;
+
+#define portCURRENT_CONTEXT()	( *( xPortContext * volatile * ) pxCurrentTCB )
+
+/* The context main() was running in when the scheduler was started, used to
+return from xPortStartScheduler() when vTaskEndScheduler() is called. */
+static ucontext_t xSchedulerContext;
+
+/* Critical nesting of the task that is running.  It is saved into the task
+context when the task is switched out. */
+static volatile unsigned portBASE_TYPE uxCriticalNesting = 0;
+
+/* Whether the tick was unblocked when the outermost critical section of the
+running task was entered, so that leaving it restores the tick as the AVR
+restores SREG.  Saved into the task context along with the nesting. */
+static volatile unsigned portBASE_TYPE uxCriticalTickWasEnabled = pdTRUE;
+
+/* The context of a task that deleted itself.  Its stack cannot be released
+until another task is running. */
+static xPortContext *pxZombieContext = NULL;
+
+/* When the last tick was raised, for usPortTickFraction(). */
+static struct timespec xLastTickTime;
+
+/*-----------------------------------------------------------*/
+
+static void prvBlockTick( sigset_t *pxOldMask );
+static void prvTaskEntry( void );
+static void prvSwitchContext( void );
+static void prvReleaseZombie( void );
+static void prvTickSignal( int iSignal );
+static void prvSetupTimerInterrupt( void );
+
+/*-----------------------------------------------------------*/
+
+static void prvBlockTick( sigset_t *pxOldMask )
+{
+sigset_t xTick;
+
+	sigemptyset( &xTick );
+	sigaddset( &xTick, SIGALRM );
+	sigprocmask( SIG_BLOCK, &xTick, pxOldMask );
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	prvBlockTick( NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+sigset_t xTick;
+
+	sigemptyset( &xTick );
+	sigaddset( &xTick, SIGALRM );
+	sigprocmask( SIG_UNBLOCK, &xTick, NULL );
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxPortSetInterruptMask( void )
+{
+sigset_t xOldMask;
+
+	prvBlockTick( &xOldMask );
+	return sigismember( &xOldMask, SIGALRM ) ? pdFALSE : pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( unsigned portBASE_TYPE uxSaved )
+{
+	if( uxSaved != pdFALSE )
+	{
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+unsigned portBASE_TYPE uxWasEnabled = uxPortSetInterruptMask();
+
+	if( uxCriticalNesting == 0 )
+	{
+		uxCriticalTickWasEnabled = uxWasEnabled;
+	}
+	uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	if( uxCriticalNesting > 0 )
+	{
+		uxCriticalNesting--;
+		if( uxCriticalNesting == 0 )
+		{
+			vPortClearInterruptMask( uxCriticalTickWasEnabled );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Create the context of a new task.  The task starts in prvTaskEntry() on its
+ * own native stack, with the tick enabled.
+ */
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
+{
+xPortContext *pxContext;
+
+	( void ) pxTopOfStack;
+
+	portENTER_CRITICAL();
+	{
+		pxContext = ( xPortContext * ) malloc( sizeof( xPortContext ) );
+		if( pxContext != NULL )
+		{
+			pxContext->pvStack = malloc( portPOSIX_STACK_SIZE );
+			if( pxContext->pvStack == NULL )
+			{
+				free( pxContext );
+				pxContext = NULL;
+			}
+		}
+	}
+	portEXIT_CRITICAL();
+
+	if( pxContext == NULL )
+	{
+		/* There is no way to report the failure through the kernel, and a task
+		without a stack cannot run. */
+		abort();
+	}
+
+	pxContext->uxCriticalNesting = 0;
+	pxContext->uxCriticalTickWasEnabled = pdTRUE;
+	pxContext->pxCode = pxCode;
+	pxContext->pvParameters = pvParameters;
+
+	getcontext( &( pxContext->xContext ) );
+	pxContext->xContext.uc_stack.ss_sp = pxContext->pvStack;
+	pxContext->xContext.uc_stack.ss_size = portPOSIX_STACK_SIZE;
+	pxContext->xContext.uc_link = NULL;
+	sigemptyset( &( pxContext->xContext.uc_sigmask ) );
+	makecontext( &( pxContext->xContext ), prvTaskEntry, 0 );
+
+	return ( portSTACK_TYPE * ) pxContext;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskEntry( void )
+{
+xPortContext *pxContext = portCURRENT_CONTEXT();
+
+	uxCriticalNesting = 0;
+	uxCriticalTickWasEnabled = pdTRUE;
+
+	portENTER_CRITICAL();
+	prvReleaseZombie();
+	portEXIT_CRITICAL();
+
+	pxContext->pxCode( pxContext->pvParameters );
+
+	/* A task function returned.  On the AVR this would crash, here the task
+	is deleted if the kernel allows it. */
+	#if ( INCLUDE_vTaskDelete == 1 )
+		vTaskDelete( NULL );
+	#endif
+	abort();
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Select the next task and switch to it.  Must be called with the tick
+ * blocked.  Returns when the calling task is switched back in.
+ */
+static void prvSwitchContext( void )
+{
+xPortContext *pxOld, *pxNew;
+
+	pxOld = portCURRENT_CONTEXT();
+	pxOld->uxCriticalNesting = uxCriticalNesting;
+	pxOld->uxCriticalTickWasEnabled = uxCriticalTickWasEnabled;
+
+	vTaskSwitchContext();
+
+	pxNew = portCURRENT_CONTEXT();
+	if( pxNew != pxOld )
+	{
+		swapcontext( &( pxOld->xContext ), &( pxNew->xContext ) );
+	}
+
+	uxCriticalNesting = pxOld->uxCriticalNesting;
+	uxCriticalTickWasEnabled = pxOld->uxCriticalTickWasEnabled;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Free the stack of a task that deleted itself, now that it is no longer the
+ * running task.  Must be called with the tick blocked.
+ */
+static void prvReleaseZombie( void )
+{
+	if( ( pxZombieContext != NULL ) && ( pxZombieContext != portCURRENT_CONTEXT() ) )
+	{
+		free( pxZombieContext->pvStack );
+		free( pxZombieContext );
+		pxZombieContext = NULL;
+	}
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Called through traceTASK_DELETE() from within vTaskDelete().
+ */
+void vPortTaskDeleted( void *pvTopOfStack )
+{
+xPortContext *pxContext = ( xPortContext * ) pvTopOfStack;
+
+	if( pxContext == portCURRENT_CONTEXT() )
+	{
+		/* Still running on that stack, release it after the yield. */
+		pxZombieContext = pxContext;
+	}
+	else
+	{
+		free( pxContext->pvStack );
+		free( pxContext );
+	}
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPortStartScheduler( void )
+{
+	/* Setup the hardware to generate the tick. */
+	prvSetupTimerInterrupt();
+
+	/* Start the first task.  The tick is blocked here, the first task starts
+	with it unblocked. */
+	swapcontext( &xSchedulerContext, &( portCURRENT_CONTEXT()->xContext ) );
+
+	/* Only get here when vTaskEndScheduler() is called. */
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval xTimer = { { 0, 0 }, { 0, 0 } };
+
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+	signal( SIGALRM, SIG_IGN );
+	setcontext( &xSchedulerContext );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Manual context switch.
+ */
+void vPortYield( void )
+{
+sigset_t xOldMask;
+
+	prvBlockTick( &xOldMask );
+	prvSwitchContext();
+	prvReleaseZombie();
+	sigprocmask( SIG_SETMASK, &xOldMask, NULL );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The tick.  SIGALRM is blocked while the handler runs, so it behaves like the
+ * TIMER0 overflow ISR on the AVR.  Stacks are never released from here, as the
+ * interrupted task may be inside malloc().
+ */
+static void prvTickSignal( int iSignal )
+{
+int iSavedErrno = errno;
+
+	( void ) iSignal;
+
+	clock_gettime( CLOCK_MONOTONIC, &xLastTickTime );
+	vTaskIncrementTick();
+
+	#if configUSE_PREEMPTION == 1
+		prvSwitchContext();
+	#endif
+
+	errno = iSavedErrno;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Microseconds since the last tick.  A tick that is blocked by the caller
+ * shows as a fraction past the end of the tick, as on the AVR.
+ */
+unsigned portSHORT usPortTickFraction( void )
+{
+struct timespec xNow;
+long lMicroseconds;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	lMicroseconds = ( xNow.tv_sec - xLastTickTime.tv_sec ) * 1000000L + ( xNow.tv_nsec - xLastTickTime.tv_nsec ) / 1000L;
+
+	if( lMicroseconds < 0 )
+	{
+		lMicroseconds = 0;
+	}
+	else if( lMicroseconds > 0xffffL )
+	{
+		lMicroseconds = 0xffffL;
+	}
+
+	return ( unsigned portSHORT ) lMicroseconds;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Microseconds from the monotonic clock, wrapping at 32 bits.
+ */
+unsigned portLONG ulPortGetTimestamp( void )
+{
+struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( unsigned portLONG ) ( xNow.tv_sec * 1000000L + xNow.tv_nsec / 1000L );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Setup an interval timer to generate the tick.
+ */
+static void prvSetupTimerInterrupt( void )
+{
+struct sigaction xAction;
+struct itimerval xTimer;
+
+	xAction.sa_handler = prvTickSignal;
+	xAction.sa_flags = SA_RESTART;
+	sigemptyset( &xAction.sa_mask );
+	sigaction( SIGALRM, &xAction, NULL );
+
+	xTimer.it_interval.tv_sec = 0;
+	xTimer.it_interval.tv_usec = 1000000UL / configTICK_RATE_HZ;
+	xTimer.it_value = xTimer.it_interval;
+	clock_gettime( CLOCK_MONOTONIC, &xLastTickTime );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+}
+/*-----------------------------------------------------------*/
+
+#endif /* DUINOS_POSIX_PORT */
@@ -0,0 +1,117 @@
+/*
+	POSIX host port for DuinOS.
+
+	This port runs the unmodified DuinOS kernel (tasks.c, queue.c, list.c and
+	the heaps) as an ordinary Linux process, so the scheduler, queues and heaps
+	can be exercised and benchmarked without a Teensy attached.  Each task runs
+	on its own ucontext and the tick is simulated with SIGALRM.  "Interrupts"
+	are the tick signal, so disabling interrupts blocks SIGALRM.
+
+	The port is selected by defining DUINOS_POSIX_PORT - see DuinOS/posix/Makefile.
+
+	This file is the POSIX counterpart of DuinOS/portmacro.h and follows the
+	FreeRTOS licensing of that file.
+*/
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------
+ * Port specific definitions.
+ *
+ * The types mirror the widths used on the AVR so that tick overflow, priority
+ * and queue arithmetic behave the same way as on the target.
+ *-----------------------------------------------------------
+ */
+
+/* Type definitions. */
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		int
+#define portSHORT		short
+#define portSTACK_TYPE	unsigned portCHAR
+#define portBASE_TYPE	char
+
+#if( configUSE_16_BIT_TICKS == 1 )
+	typedef unsigned portSHORT portTickType;
+	#define portMAX_DELAY ( portTickType ) 0xffff
+#else
+	typedef unsigned portLONG portTickType;
+	#define portMAX_DELAY ( portTickType ) 0xffffffff
+#endif
+/*-----------------------------------------------------------*/
+
+/* Critical section management.  The nesting count is kept per task, so a task
+may yield from within a critical section just as it can on the AVR. */
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+extern void vPortDisableInterrupts( void );
+extern void vPortEnableInterrupts( void );
+
+#define portENTER_CRITICAL()		vPortEnterCritical()
+#define portEXIT_CRITICAL()			vPortExitCritical()
+
+#define portDISABLE_INTERRUPTS()	vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()		vPortEnableInterrupts()
+
+/* Interrupt-off sections outside the kernel, see DuinOS/portmacro.h.  The
+saved state is whether the tick was unblocked.  The tick is the only
+interrupt, so masking it is the same as disabling interrupts. */
+extern unsigned portBASE_TYPE uxPortSetInterruptMask( void );
+extern void vPortClearInterruptMask( unsigned portBASE_TYPE uxSaved );
+
+#define portINTERRUPTS_OFF( uxSaved )		( uxSaved ) = uxPortSetInterruptMask()
+#define portINTERRUPTS_RESTORE( uxSaved )	vPortClearInterruptMask( uxSaved )
+#define portINTERRUPTS_OFF_FROM_TASK()		vPortDisableInterrupts()
+#define portINTERRUPTS_ON_FROM_TASK()		vPortEnableInterrupts()
+#define portTICK_MASK( uxSaved )			( uxSaved ) = uxPortSetInterruptMask()
+#define portTICK_UNMASK( uxSaved )			vPortClearInterruptMask( uxSaved )
+/*-----------------------------------------------------------*/
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_RATE_MS			( ( portTickType ) 1000 / configTICK_RATE_HZ )
+#define portMS_TO_TICKS( ulMs )		( ( portTickType ) ( ( ( unsigned portLONG ) ( ulMs ) * configTICK_RATE_HZ + 999UL ) / 1000UL ) )
+#define portBYTE_ALIGNMENT			8
+#define portNOP()
+
+/* Each task runs on a native stack of this many bytes, allocated by the port.
+The stack the kernel allocates for the task is only used to hold the pointer to
+the task's context, so AVR sized stack depths can be used unchanged. */
+#ifndef portPOSIX_STACK_SIZE
+	#define portPOSIX_STACK_SIZE		( 64 * 1024 )
+#endif
+
+/* Sub-tick time, in microseconds since the last tick signal.  Call
+usPortTickFraction() with interrupts disabled. */
+#define portTICK_FRACTIONS			( ( unsigned portLONG ) ( 1000000UL / configTICK_RATE_HZ ) )
+#define portTICK_FRACTION_TO_US( ulFractions )	( ( unsigned portLONG ) ( ulFractions ) )
+extern unsigned portSHORT usPortTickFraction( void );
+
+/* Free running time in the same units. */
+extern unsigned portLONG ulPortGetTimestamp( void );
+/*-----------------------------------------------------------*/
+
+/* Kernel utilities. */
+extern void vPortYield( void );
+#define portYIELD()					vPortYield()
+
+/* The native stack of a deleted task is released by the port. */
+extern void vPortTaskDeleted( void *pvTopOfStack );
+#define traceTASK_DELETE( pxTaskToDelete )	vPortTaskDeleted( ( void * ) ( pxTaskToDelete )->pxTopOfStack )
+/*-----------------------------------------------------------*/
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
@@ -0,0 +1,74 @@
+/*
+	Priority order test for the POSIX port.
+
+	One task runs at each priority from FIRST_PRIORITY to
+	configMAX_PRIORITIES - 1, and all of them are released on the same tick
+	by vTaskDelayUntil().  Each logs its priority when it runs.  The main
+	loop, released on that tick too but below all of them, checks that they
+	ran from the highest priority down.  It prints the counts and exits
+	with 1 on any error.
+*/
+
+#include <stdio.h>
+#include <WProgram.h>
+
+#define ROUNDS				400
+#define PERIOD				5
+#define FIRST_PRIORITY		(HIGH_PRIORITY + 1)
+#define TASKS				(configMAX_PRIORITIES - FIRST_PRIORITY)
+
+static volatile unsigned portBASE_TYPE ran[TASKS];
+static volatile unsigned count;
+static unsigned long errors;
+
+static void released(void *pvParameters)
+{
+	portTickType lastRelease = 0;
+
+	for (;;) {
+		vTaskDelayUntil(&lastRelease, PERIOD);
+		if (count < TASKS)
+			ran[count] = (unsigned portBASE_TYPE)(unsigned long)pvParameters;
+		count++;
+	}
+}
+
+void setup()
+{
+	//Created out of order, so that no list happens to hold them sorted:
+	for (unsigned long i = 0; i < TASKS; i++) {
+		unsigned long priority = FIRST_PRIORITY + (i * 5) % TASKS;
+
+		xTaskCreate(released, tskTASK_NAME("released"), configMINIMAL_STACK_SIZE,
+		            (void *)priority, priority, NULL);
+	}
+
+	initMainLoopPriority(HIGH_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	static portTickType lastRelease = 0;
+	static unsigned rounds;
+
+	vTaskDelayUntil(&lastRelease, PERIOD);
+
+	if (count != TASKS)
+		errors++;
+	for (unsigned i = 0; i < TASKS; i++)
+		if (ran[i] != configMAX_PRIORITIES - 1 - i)
+			errors++;
+	count = 0;
+
+	if (++rounds < ROUNDS)
+		return;
+
+	suspendAll();
+	printf("%u rounds of %u tasks, priorities %u to %u, %lu errors\n",
+	       rounds, (unsigned)TASKS, (unsigned)FIRST_PRIORITY,
+	       (unsigned)configMAX_PRIORITIES - 1, errors);
+	fflush(stdout);
+	exit(errors ? 1 : 0);
+}
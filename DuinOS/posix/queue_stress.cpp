@@ -0,0 +1,93 @@
+/*
+	Queue and scheduler stress test for the POSIX port.
+
+	Two producers feed a consumer through a queue while the main loop checks
+	that nothing was lost or reordered.  The run stops after RUN_TIME_MS and
+	prints the number of messages passed and context switches per second.
+*/
+
+#include <stdio.h>
+#include <WProgram.h>
+#include "DuinOS/queue.h"
+
+#define RUN_TIME_MS		3000
+#define QUEUE_LENGTH	8
+
+static xQueueHandle queue;
+static volatile unsigned long sent[2];
+static volatile unsigned long received[2];
+static volatile unsigned long errors;
+static unsigned long lastSeen[2];
+
+static void produce(unsigned long id)
+{
+	unsigned long message = (id << 24) | (sent[id] & 0xffffff);
+
+	//Counted first, the consumer may run before xQueueSend() returns:
+	sent[id]++;
+	if (xQueueSend(queue, &message, portMAX_DELAY) != pdPASS)
+		errors++;
+}
+
+taskLoop(producer0)
+{
+	produce(0);
+}
+
+taskLoop(producer1)
+{
+	produce(1);
+	//The second producer also gives up the CPU on its own:
+	nextTask();
+}
+
+taskLoop(consumer)
+{
+	unsigned long message, id, count;
+
+	if (xQueueReceive(queue, &message, portMAX_DELAY) != pdPASS)
+		return;
+
+	id = message >> 24;
+	count = message & 0xffffff;
+	if (id > 1 || (received[id] && count != ((lastSeen[id] + 1) & 0xffffff)))
+		errors++;
+	lastSeen[id] = count;
+	received[id]++;
+}
+
+void setup()
+{
+	queue = xQueueCreate(QUEUE_LENGTH, sizeof(unsigned long));
+
+	createTaskLoop(producer0, NORMAL_PRIORITY);
+	createTaskLoop(producer1, NORMAL_PRIORITY);
+	createTaskLoop(consumer, HIGH_PRIORITY);
+
+	//The producers never block for long, so the checker must outrank them:
+	initMainLoopPriority(HIGH_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	static unsigned long start;
+	unsigned long elapsed;
+
+	if (!start)
+		start = millis();
+
+	delay(500);
+
+	elapsed = millis() - start;
+	if (elapsed < RUN_TIME_MS)
+		return;
+
+	suspendAll();
+	printf("%lu ms: sent %lu/%lu, received %lu/%lu, %lu messages/s, %lu errors\n",
+	       elapsed, sent[0], sent[1], received[0], received[1],
+	       (received[0] + received[1]) * 1000UL / elapsed, errors);
+	fflush(stdout);
+	exit(errors ? 1 : 0);
+}
@@ -0,0 +1,127 @@
+/*
+	Missed tick catch-up test for the POSIX port.
+
+	A task suspends the scheduler for SUSPEND_MS at a time, so that
+	xTaskResumeAll() has hundreds of ticks to catch up on every time.  Three
+	other tasks meanwhile delay for 1, 7 and 113 ticks in a loop.  The run
+	lasts until the 16 bit tick count has wrapped, which the suspending task
+	arranges to happen while the scheduler is suspended.
+
+	No delay may end early, and no task may be left waiting for more than
+	its delay plus one suspension.  It prints the counts and exits with 1 on
+	any error.
+*/
+
+#include <stdio.h>
+#include <WProgram.h>
+
+#define SUSPEND_MS			300
+#define GAP_MS				37
+#define AFTER_WRAP_MS		5000
+//Scheduling slack on a loaded host:
+#define SLACK_MS			200
+
+static const portTickType delays[3] = { 1, 7, 113 };
+static volatile unsigned long wakes[3];
+static volatile unsigned long lastWake[3];
+static volatile unsigned long early, late;
+static volatile unsigned long suspensions, wrapsInside;
+
+static void delayFor(unsigned id)
+{
+	portTickType before, elapsed;
+
+	before = xTaskGetTickCount();
+	vTaskDelay(delays[id]);
+	elapsed = xTaskGetTickCount() - before;
+
+	if (elapsed < delays[id])
+		early++;
+	if (elapsed > delays[id] + portMS_TO_TICKS(SUSPEND_MS + SLACK_MS))
+		late++;
+	lastWake[id] = millis();
+	wakes[id]++;
+}
+
+taskLoop(delay1)
+{
+	delayFor(0);
+}
+
+taskLoop(delay7)
+{
+	delayFor(1);
+}
+
+taskLoop(delay113)
+{
+	delayFor(2);
+}
+
+taskLoop(suspender)
+{
+	portTickType before = xTaskGetTickCount();
+
+	suspendAll();
+	wiring_delay(SUSPEND_MS);
+	resumeAll();
+
+	if (xTaskGetTickCount() < before)
+		wrapsInside++;
+	suspensions++;
+
+	//Skip the gap when the tick count is about to wrap, so that it wraps
+	//while the scheduler is suspended:
+	if ((portTickType)(0 - xTaskGetTickCount()) > portMS_TO_TICKS(GAP_MS + SLACK_MS))
+		delay(GAP_MS);
+}
+
+void setup()
+{
+	createTaskLoop(delay1, HIGH_PRIORITY);
+	createTaskLoop(delay7, HIGH_PRIORITY);
+	createTaskLoop(delay113, HIGH_PRIORITY);
+	createTaskLoop(suspender, NORMAL_PRIORITY);
+
+	initMainLoopPriority(HIGH_PRIORITY);
+
+	startDuinOS();
+}
+
+void loop()
+{
+	static unsigned long start, wrappedAt;
+	static portTickType lastTicks;
+	portTickType ticks;
+	unsigned long now;
+
+	if (!start) {
+		start = millis();
+		for (unsigned id = 0; id < 3; id++)
+			lastWake[id] = start;
+	}
+
+	delay(500);
+
+	ticks = xTaskGetTickCount();
+	now = millis();
+	if (ticks < lastTicks && !wrappedAt)
+		wrappedAt = now;
+	lastTicks = ticks;
+
+	//A lost wake leaves a task waiting forever:
+	for (unsigned id = 0; id < 3; id++)
+		if (now - lastWake[id] > delays[id] + SUSPEND_MS + 500UL + SLACK_MS)
+			late++;
+
+	if (!wrappedAt || now - wrappedAt < AFTER_WRAP_MS)
+		return;
+
+	suspendAll();
+	printf("%lu ms: %lu suspensions, %lu wrapped inside, wakes %lu/%lu/%lu, "
+	       "%lu early, %lu late\n",
+	       now - start, suspensions, wrapsInside, wakes[0], wakes[1], wakes[2],
+	       early, late);
+	fflush(stdout);
+	exit(early || late || wrapsInside != 1 ? 1 : 0);
+}
@@ -71,6 +71,14 @@
 #define uxRecursiveCallCount			pcReadFrom
 #define queueQUEUE_IS_MUTEX				NULL
 
+#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+	/* A mutex with a ceiling raises its holder as soon as it is taken, so a
+	task blocking on it has no priority to pass on. */
+	#define queueMUTEX_INHERITS( pxQueue )	( ( pxQueue )->xUsesCeiling == pdFALSE )
+#else
+	#define queueMUTEX_INHERITS( pxQueue )	pdTRUE
+#endif
+
 /* Semaphores do not actually store or copy data, so have an items size of
 zero. */
 #define queueSEMAPHORE_QUEUE_ITEM_LENGTH ( 0 )
@@ -99,6 +107,11 @@ typedef struct QueueDefinition
 	signed portBASE_TYPE xRxLock;			/*< Stores the number of items received from the queue (removed from the queue) while the queue was locked.  Set to queueUNLOCKED when the queue is not locked. */
 	signed portBASE_TYPE xTxLock;			/*< Stores the number of items transmitted to the queue (added to the queue) while the queue was locked.  Set to queueUNLOCKED when the queue is not locked. */
 
+	#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+		unsigned portBASE_TYPE uxCeiling;	/*< The priority the holder of a mutex is raised to when it takes the mutex. */
+		signed portBASE_TYPE xUsesCeiling;	/*< pdTRUE for a ceiling mutex, pdFALSE if the mutex uses priority inheritance instead.  Kept apart from uxCeiling, as 0 is a valid ceiling. */
+	#endif
+
 } xQUEUE;
 /*-----------------------------------------------------------*/
 
@@ -109,12 +122,20 @@ typedef struct QueueDefinition
  */
 typedef xQUEUE * xQueueHandle;
 
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+	/* xStaticQueue in FreeRTOS.h must stay the size of a queue. */
+	typedef char queueSTATIC_QUEUE_SIZE_CHECK[ ( sizeof( xStaticQueue ) == sizeof( xQUEUE ) ) ? 1 : -1 ];
+#endif
+
 /*
  * Prototypes for public functions are included here so we don't have to
  * include the API header file (as it defines xQueueHandle differently).  These
  * functions are documented in the API header file.
  */
 xQueueHandle xQueueCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize );
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+	xQueueHandle xQueueCreateStatic( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned portCHAR *pucQueueStorage, xStaticQueue *pxStaticQueue );
+#endif
 signed portBASE_TYPE xQueueGenericSend( xQueueHandle xQueue, const void * const pvItemToQueue, portTickType xTicksToWait, portBASE_TYPE xCopyPosition );
 unsigned portBASE_TYPE uxQueueMessagesWaiting( const xQueueHandle pxQueue );
 void vQueueDelete( xQueueHandle xQueue );
@@ -122,6 +143,7 @@ signed portBASE_TYPE xQueueGenericSendFromISR( xQueueHandle pxQueue, const void
 signed portBASE_TYPE xQueueGenericReceive( xQueueHandle pxQueue, void * const pvBuffer, portTickType xTicksToWait, portBASE_TYPE xJustPeeking );
 signed portBASE_TYPE xQueueReceiveFromISR( xQueueHandle pxQueue, void * const pvBuffer, signed portBASE_TYPE *pxTaskWoken );
 xQueueHandle xQueueCreateMutex( void );
+xQueueHandle xQueueCreateCeilingMutex( unsigned portBASE_TYPE uxCeiling );
 xQueueHandle xQueueCreateCountingSemaphore( unsigned portBASE_TYPE uxCountValue, unsigned portBASE_TYPE uxInitialCount );
 portBASE_TYPE xQueueTakeMutexRecursive( xQueueHandle xMutex, portTickType xBlockTime );
 portBASE_TYPE xQueueGiveMutexRecursive( xQueueHandle xMutex );
@@ -281,6 +303,46 @@ size_t xQueueSizeInBytes;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+
+	xQueueHandle xQueueCreateStatic( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned portCHAR *pucQueueStorage, xStaticQueue *pxStaticQueue )
+	{
+	xQUEUE *pxNewQueue = ( xQUEUE * ) pxStaticQueue;
+
+		if( uxQueueLength == ( unsigned portBASE_TYPE ) 0 )
+		{
+			return NULL;
+		}
+
+		/* The same initial state as xQueueCreate(), in the caller's memory. */
+		pxNewQueue->pcHead = ( signed portCHAR * ) pucQueueStorage;
+		pxNewQueue->pcTail = pxNewQueue->pcHead + ( uxQueueLength * uxItemSize );
+		pxNewQueue->uxMessagesWaiting = 0;
+		pxNewQueue->pcWriteTo = pxNewQueue->pcHead;
+		pxNewQueue->pcReadFrom = pxNewQueue->pcHead + ( ( uxQueueLength - 1 ) * uxItemSize );
+		pxNewQueue->uxLength = uxQueueLength;
+		pxNewQueue->uxItemSize = uxItemSize;
+		pxNewQueue->xRxLock = queueUNLOCKED;
+		pxNewQueue->xTxLock = queueUNLOCKED;
+
+		#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+		{
+			pxNewQueue->uxCeiling = 0;
+			pxNewQueue->xUsesCeiling = pdFALSE;
+		}
+		#endif
+
+		vListInitialise( &( pxNewQueue->xTasksWaitingToSend ) );
+		vListInitialise( &( pxNewQueue->xTasksWaitingToReceive ) );
+
+		traceQUEUE_CREATE( pxNewQueue );
+
+		return pxNewQueue;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 #if ( configUSE_MUTEXES == 1 )
 
 	xQueueHandle xQueueCreateMutex( void )
@@ -294,6 +356,12 @@ size_t xQueueSizeInBytes;
 			/* Information required for priority inheritance. */
 			pxNewQueue->pxMutexHolder = NULL;
 			pxNewQueue->uxQueueType = queueQUEUE_IS_MUTEX;
+			#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+			{
+				pxNewQueue->uxCeiling = ( unsigned portBASE_TYPE ) 0;
+				pxNewQueue->xUsesCeiling = pdFALSE;
+			}
+			#endif
 
 			/* Queues used as a mutex no data is actually copied into or out
 			of the queue. */
@@ -329,6 +397,27 @@ size_t xQueueSizeInBytes;
 #endif /* configUSE_MUTEXES */
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+
+	xQueueHandle xQueueCreateCeilingMutex( unsigned portBASE_TYPE uxCeiling )
+	{
+	xQUEUE *pxNewQueue;
+
+		pxNewQueue = xQueueCreateMutex();
+		if( pxNewQueue != NULL )
+		{
+			/* The mutex is not visible to any other task yet, so the ceiling
+			can be set after it has been created. */
+			pxNewQueue->uxCeiling = uxCeiling;
+			pxNewQueue->xUsesCeiling = pdTRUE;
+		}
+
+		return pxNewQueue;
+	}
+
+#endif /* configUSE_MUTEX_PRIORITY_CEILING */
+/*-----------------------------------------------------------*/
+
 #if configUSE_RECURSIVE_MUTEXES == 1
 
 	portBASE_TYPE xQueueGiveMutexRecursive( xQueueHandle pxMutex )
@@ -654,6 +743,18 @@ xTimeOutType xTimeOut;
 						}
 						#endif
 
+						#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+						{
+							if( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX )
+							{
+								/* Under the ceiling protocol the holder runs at the
+								ceiling from now on, so no task that shares the mutex
+								can preempt it while it holds the mutex. */
+								vTaskPriorityRaiseToCeiling( ( void * ) pxQueue->pxMutexHolder, pxQueue->uxCeiling );
+							}
+						}
+						#endif
+
 						if( listLIST_IS_EMPTY( &( pxQueue->xTasksWaitingToSend ) ) == pdFALSE )
 						{
 							if( xTaskRemoveFromEventList( &( pxQueue->xTasksWaitingToSend ) ) == pdTRUE )
@@ -715,7 +816,7 @@ xTimeOutType xTimeOut;
 
 						#if ( configUSE_MUTEXES == 1 )
 						{
-							if( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX )
+							if( ( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX ) && queueMUTEX_INHERITS( pxQueue ) )
 							{
 								portENTER_CRITICAL();
 									vTaskPriorityInherit( ( void * ) pxQueue->pxMutexHolder );
@@ -837,6 +938,18 @@ signed portCHAR *pcOriginalReadPosition;
 					}
 					#endif
 
+					#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+					{
+						if( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX )
+						{
+							/* Under the ceiling protocol the holder runs at the
+							ceiling from now on, so no task that shares the mutex
+							can preempt it while it holds the mutex. */
+							vTaskPriorityRaiseToCeiling( ( void * ) pxQueue->pxMutexHolder, pxQueue->uxCeiling );
+						}
+					}
+					#endif
+
 					if( listLIST_IS_EMPTY( &( pxQueue->xTasksWaitingToSend ) ) == pdFALSE )
 					{
 						if( xTaskRemoveFromEventList( &( pxQueue->xTasksWaitingToSend ) ) == pdTRUE )
@@ -907,7 +1020,7 @@ signed portCHAR *pcOriginalReadPosition;
 
 				#if ( configUSE_MUTEXES == 1 )
 				{
-					if( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX )
+					if( ( pxQueue->uxQueueType == queueQUEUE_IS_MUTEX ) && queueMUTEX_INHERITS( pxQueue ) )
 					{
 						portENTER_CRITICAL();
 						{
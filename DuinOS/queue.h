@@ -123,6 +123,35 @@ typedef void * xQueueHandle;
  */
 xQueueHandle xQueueCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize );
 
+/**
+ * queue. h
+ * <pre>
+ xQueueHandle xQueueCreateStatic(
+                              unsigned portBASE_TYPE uxQueueLength,
+                              unsigned portBASE_TYPE uxItemSize,
+                              unsigned portCHAR *pucQueueStorage,
+                              xStaticQueue *pxStaticQueue
+                          );
+ * </pre>
+ *
+ * As xQueueCreate(), but the queue lives in memory supplied by the caller,
+ * usually static variables, instead of being taken from the heap.
+ * pucQueueStorage must hold queueSTATIC_STORAGE_SIZE( uxQueueLength,
+ * uxItemSize ) bytes.  A static queue must never be passed to vQueueDelete().
+ *
+ * Only available if configUSE_STATIC_ALLOCATION is 1.
+ *
+ * @return A handle to the queue, or NULL if uxQueueLength is 0.
+ *
+ * \defgroup xQueueCreateStatic xQueueCreateStatic
+ * \ingroup QueueManagement
+ */
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+	#define queueSTATIC_STORAGE_SIZE( uxQueueLength, uxItemSize )	( ( ( size_t ) ( uxQueueLength ) * ( size_t ) ( uxItemSize ) ) + ( size_t ) 1 )
+
+	xQueueHandle xQueueCreateStatic( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned portCHAR *pucQueueStorage, xStaticQueue *pxStaticQueue );
+#endif
+
 /**
  * queue. h
  * <pre>
@@ -1205,6 +1234,7 @@ signed portBASE_TYPE xQueueCRReceive( xQueueHandle pxQueue, void *pvBuffer, port
  * xSemaphoreCreateCounting() instead of calling these functions directly.
  */
 xQueueHandle xQueueCreateMutex( void );
+xQueueHandle xQueueCreateCeilingMutex( unsigned portBASE_TYPE uxCeiling );
 xQueueHandle xQueueCreateCountingSemaphore( unsigned portBASE_TYPE uxCountValue, unsigned portBASE_TYPE uxInitialCount );
 
 /*
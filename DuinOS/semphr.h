@@ -581,6 +581,55 @@ typedef xQueueHandle xSemaphoreHandle;
  */
 #define xSemaphoreCreateMutex() xQueueCreateMutex()
 
+/**
+ * semphr. h
+ * <pre>xSemaphoreHandle xSemaphoreCreateCeilingMutex( unsigned portBASE_TYPE uxCeiling )</pre>
+ *
+ * <i>Macro</i> that implements a mutex semaphore that uses the priority
+ * ceiling protocol instead of priority inheritance.  Only available when
+ * configUSE_MUTEX_PRIORITY_CEILING is set to 1.
+ *
+ * A task that takes the mutex is raised to uxCeiling straight away, and
+ * goes back to its own priority when it gives the mutex.  A task that blocks
+ * on the mutex does not change the priority of the holder.  uxCeiling must
+ * be at least the priority of the highest priority task that takes the
+ * mutex, the holder then cannot be preempted by any other task sharing it,
+ * and a high priority task is delayed by at most one critical section.
+ *
+ * As with xSemaphoreCreateMutex(), a task 'taking' the semaphore MUST ALWAYS
+ * 'give' it back, and the semaphore cannot be used from within interrupt
+ * service routines.  Giving any mutex sets the holder back to its base
+ * priority, so ceiling mutexes should not be nested.
+ *
+ * @param uxCeiling The priority the holder runs at.  Values above
+ *		configMAX_PRIORITIES - 1 are capped.  A ceiling of 0 is kept as such:
+ *		the holder is not raised, and tasks blocking on the mutex do not
+ *		lend it their priority either.
+ *
+ * @return xSemaphore Handle to the created mutex semaphore.  Should be of type 
+ *		xSemaphoreHandle.
+ *
+ * Example usage:
+ <pre>
+ xSemaphoreHandle xSPIMutex;
+
+ void vATask( void * pvParameters )
+ {
+    // The SPI bus is shared by tasks up to priority 2.
+    xSPIMutex = xSemaphoreCreateCeilingMutex( 2 );
+
+    if( xSemaphoreTake( xSPIMutex, portMAX_DELAY ) == pdTRUE )
+    {
+        // Runs at priority 2 until the mutex is given back.
+        xSemaphoreGive( xSPIMutex );
+    }
+ }
+ </pre>
+ * \defgroup xSemaphoreCreateCeilingMutex xSemaphoreCreateCeilingMutex
+ * \ingroup Semaphores
+ */
+#define xSemaphoreCreateCeilingMutex( uxCeiling ) xQueueCreateCeilingMutex( ( unsigned portBASE_TYPE ) ( uxCeiling ) )
+
 
 /**
  * semphr. h
@@ -0,0 +1,169 @@
+/*
+	Typed, statically allocated tasks, queues and semaphores for C++ sketches.
+
+	+ Task<StackBytes, Priority> holds the TCB and the stack of one task:
+
+		Task<128, NORMAL_PRIORITY> blinker;
+		...
+		blinker.start(blink, tskTASK_NAME("blink"));
+
+	+ Queue<T, N> holds N items of type T.  Only a T can be sent or received,
+	  so the item size cannot disagree with the queue:
+
+		Queue<unsigned int, 8> samples;
+		...
+		samples.send(value, portMAX_DELAY);
+
+	+ BinarySemaphore is created given, like vSemaphoreCreateBinary().
+
+	All of them live wherever they are declared, usually as globals, so no heap
+	is used.  Their methods are inline calls to the queue and task API, and
+	bad template arguments (a priority that does not exist, a stack below
+	configMINIMAL_STACK_SIZE, an empty queue, more than 255 items or items
+	over 255 bytes) fail to compile.  Objects cannot be copied, and must not
+	be deleted through the C API: the kernel never frees their storage,
+	vTaskDelete() only takes the task off the lists.  handle() gives the plain handle for everything else.
+
+	Enabled by setting configUSE_STATIC_ALLOCATION to 1 in FreeRTOSConfig.h.
+*/
+
+#ifndef STATIC_RTOS_H
+#define STATIC_RTOS_H
+
+#ifndef INC_FREERTOS_H
+	#error "#include FreeRTOS.h" must appear in source files before "#include static_rtos.h"
+#endif
+
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#if ( configUSE_STATIC_ALLOCATION == 1 ) && defined( __cplusplus )
+
+template< unsigned int StackBytes, unsigned portBASE_TYPE Priority >
+class Task
+{
+	/* Compile time checks, an array of -1 elements if they fail. */
+	typedef char PriorityTooHigh[ ( Priority < configMAX_PRIORITIES ) ? 1 : -1 ];
+	typedef char StackTooSmall[ ( StackBytes >= configMINIMAL_STACK_SIZE * sizeof( portSTACK_TYPE ) ) ? 1 : -1 ];
+
+public:
+	Task() : xHandle( NULL ) {}
+
+	/* Create the task, once.  Returns pdPASS, pdFAIL if it was started
+	already (its TCB is on the kernel lists), or an error code from
+	projdefs.h. */
+	signed portBASE_TYPE start( pdTASK_CODE pxCode, const signed portCHAR *pcName, void *pvParameters = NULL )
+	{
+		if( xHandle != NULL )
+		{
+			return pdFAIL;
+		}
+		return xTaskCreateStatic( pxCode, pcName, StackBytes / sizeof( portSTACK_TYPE ), pvParameters, Priority, &xHandle, xStack, &xTCB );
+	}
+
+	xTaskHandle handle() const { return xHandle; }
+
+private:
+	Task( const Task & );
+	Task &operator=( const Task & );
+
+	xStaticTask xTCB;
+	portSTACK_TYPE xStack[ StackBytes / sizeof( portSTACK_TYPE ) ];
+	xTaskHandle xHandle;
+};
+
+template< typename T, unsigned portBASE_TYPE N >
+class Queue
+{
+	typedef char QueueIsEmpty[ ( N > 0 ) ? 1 : -1 ];
+	/* The length and item size reach the kernel as unsigned portBASE_TYPE,
+	one byte on this port. */
+	typedef char QueueTooLong[ ( N <= 255 ) ? 1 : -1 ];
+	typedef char ItemTooBig[ ( sizeof( T ) <= 255 ) ? 1 : -1 ];
+
+public:
+	Queue() : xHandle( xQueueCreateStatic( N, sizeof( T ), ucStorage, &xQueue ) ) {}
+
+	/* Same results as the functions of queue.h they call. */
+	signed portBASE_TYPE send( const T &xItem, portTickType xTicksToWait = 0 )
+	{
+		return xQueueGenericSend( xHandle, &xItem, xTicksToWait, queueSEND_TO_BACK );
+	}
+
+	signed portBASE_TYPE sendToFront( const T &xItem, portTickType xTicksToWait = 0 )
+	{
+		return xQueueGenericSend( xHandle, &xItem, xTicksToWait, queueSEND_TO_FRONT );
+	}
+
+	signed portBASE_TYPE receive( T &xItem, portTickType xTicksToWait = portMAX_DELAY )
+	{
+		return xQueueGenericReceive( xHandle, &xItem, xTicksToWait, pdFALSE );
+	}
+
+	signed portBASE_TYPE peek( T &xItem, portTickType xTicksToWait = 0 )
+	{
+		return xQueueGenericReceive( xHandle, &xItem, xTicksToWait, pdTRUE );
+	}
+
+	signed portBASE_TYPE sendFromISR( const T &xItem, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+		return xQueueGenericSendFromISR( xHandle, &xItem, pxHigherPriorityTaskWoken, queueSEND_TO_BACK );
+	}
+
+	signed portBASE_TYPE receiveFromISR( T &xItem, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+		return xQueueReceiveFromISR( xHandle, &xItem, pxHigherPriorityTaskWoken );
+	}
+
+	unsigned portBASE_TYPE waiting() const { return uxQueueMessagesWaiting( xHandle ); }
+	unsigned portBASE_TYPE waitingFromISR() const { return uxQueueMessagesWaitingFromISR( xHandle ); }
+
+	xQueueHandle handle() const { return xHandle; }
+
+private:
+	Queue( const Queue & );
+	Queue &operator=( const Queue & );
+
+	xStaticQueue xQueue;
+	unsigned portCHAR ucStorage[ N * sizeof( T ) + 1 ];
+	xQueueHandle xHandle;
+};
+
+class BinarySemaphore
+{
+public:
+	BinarySemaphore() : xHandle( xQueueCreateStatic( 1, semSEMAPHORE_QUEUE_ITEM_LENGTH, ucStorage, &xQueue ) )
+	{
+		give();
+	}
+
+	signed portBASE_TYPE take( portTickType xBlockTime = portMAX_DELAY )
+	{
+		return xQueueGenericReceive( xHandle, NULL, xBlockTime, pdFALSE );
+	}
+
+	signed portBASE_TYPE give()
+	{
+		return xQueueGenericSend( xHandle, NULL, semGIVE_BLOCK_TIME, queueSEND_TO_BACK );
+	}
+
+	signed portBASE_TYPE giveFromISR( signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+		return xQueueGenericSendFromISR( xHandle, NULL, pxHigherPriorityTaskWoken, queueSEND_TO_BACK );
+	}
+
+	xSemaphoreHandle handle() const { return xHandle; }
+
+private:
+	BinarySemaphore( const BinarySemaphore & );
+	BinarySemaphore &operator=( const BinarySemaphore & );
+
+	xStaticQueue xQueue;
+	unsigned portCHAR ucStorage[ 1 ];
+	xSemaphoreHandle xHandle;
+};
+
+#endif
+
+#endif /* STATIC_RTOS_H */
@@ -96,6 +96,37 @@ typedef struct xTIME_OUT
  */
 #define tskIDLE_PRIORITY			( ( unsigned portBASE_TYPE ) 0 )
 
+/*
+ * Wraps a literal task name for passing to xTaskCreate.  When
+ * configUSE_PROGMEM_TASK_NAMES is 1 the TCB only keeps a pointer to the name,
+ * so the literal is placed in flash instead of being copied into RAM.  This
+ * must be used from within a function.
+ *
+ * \ingroup Tasks
+ */
+#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+	#include <avr/pgmspace.h>
+	#define tskTASK_NAME( pcName )	( ( const signed portCHAR * ) PSTR( pcName ) )
+#else
+	#define tskTASK_NAME( pcName )	( ( const signed portCHAR * ) ( pcName ) )
+#endif
+
+/*
+ * Type of the name vApplicationStackOverflowHook() is given:
+ *
+ * void vApplicationStackOverflowHook( xTaskHandle *pxTask, tskTASK_NAME_TYPE pcTaskName );
+ *
+ * When configUSE_PROGMEM_TASK_NAMES is 1 it points to program memory, so it
+ * must be read with pgm_read_byte() or printed with %S, never as a RAM string.
+ *
+ * \ingroup Tasks
+ */
+#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+	#define tskTASK_NAME_TYPE		const signed portCHAR *
+#else
+	#define tskTASK_NAME_TYPE		signed portCHAR *
+#endif
+
 /**
  * task. h
  *
@@ -159,6 +190,12 @@ typedef struct xTIME_OUT
 #define taskSCHEDULER_RUNNING		1
 #define taskSCHEDULER_SUSPENDED		2
 
+/* Windows accepted by uxTaskGetCpuLoad(). */
+#define tskCPU_LOAD_1S				0
+#define tskCPU_LOAD_10S				1
+#define tskCPU_LOAD_60S				2
+#define tskCPU_LOAD_WINDOWS			3
+
 /*-----------------------------------------------------------
  * TASK CREATION API
  *----------------------------------------------------------*/
@@ -182,7 +219,8 @@ typedef struct xTIME_OUT
  *
  * @param pcName A descriptive name for the task.  This is mainly used to
  * facilitate debugging.  Max length defined by tskMAX_TASK_NAME_LEN - default
- * is 16.
+ * is 16.  If configUSE_PROGMEM_TASK_NAMES is 1 the name must be a string in
+ * program memory that outlives the task - use the tskTASK_NAME() macro.
  *
  * @param usStackDepth The size of the task stack specified as the number of
  * variables the stack can hold - not the number of bytes.  For example, if
@@ -232,6 +270,37 @@ typedef struct xTIME_OUT
  */
 signed portBASE_TYPE xTaskCreate( pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pvCreatedTask );
 
+/**
+ * task. h
+ *<pre>
+ portBASE_TYPE xTaskCreateStatic(
+                              pdTASK_CODE pvTaskCode,
+                              const portCHAR * const pcName,
+                              unsigned portSHORT usStackDepth,
+                              void *pvParameters,
+                              unsigned portBASE_TYPE uxPriority,
+                              xTaskHandle *pvCreatedTask,
+                              portSTACK_TYPE *puxStackBuffer,
+                              xStaticTask *pxTaskBuffer
+                          );</pre>
+ *
+ * As xTaskCreate(), but the stack and the TCB are supplied by the caller,
+ * usually as static variables, instead of being taken from the heap.
+ * puxStackBuffer must hold usStackDepth items.  Both buffers must outlive
+ * the task, and are not freed if it is deleted.
+ *
+ * Only available if configUSE_STATIC_ALLOCATION is 1.
+ *
+ * @return pdPASS if the task was successfully created and added to a ready
+ * list.
+ *
+ * \defgroup xTaskCreateStatic xTaskCreateStatic
+ * \ingroup Tasks
+ */
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+	signed portBASE_TYPE xTaskCreateStatic( pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pvCreatedTask, portSTACK_TYPE *puxStackBuffer, xStaticTask *pxTaskBuffer );
+#endif
+
 /**
  * task. h
  * <pre>void vTaskDelete( xTaskHandle pxTask );</pre>
@@ -830,6 +899,29 @@ portTickType xTaskGetTickCount( void );
  */
 unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void );
 
+/**
+ * task. h
+ * <PRE>unsigned portBASE_TYPE uxTaskGetCpuLoad( unsigned portBASE_TYPE uxWindow );</PRE>
+ *
+ * configUSE_CPU_LOAD must be defined as 1 for this function to be
+ * available.
+ *
+ * The kernel times the idle task each time it is switched in or out, and
+ * once a second works out how much of that second was spent outside of it.
+ * Time spent in interrupts counts as load.
+ *
+ * @param uxWindow tskCPU_LOAD_1S for the last second, tskCPU_LOAD_10S or
+ * tskCPU_LOAD_60S for the average over the last 10 or 60 seconds.  Until the
+ * scheduler has run that long, the average is over the seconds so far.
+ *
+ * @return The processor load in percent, 0 to 100.  All figures read 0
+ * until the scheduler has run for a second.
+ *
+ * \page uxTaskGetCpuLoad uxTaskGetCpuLoad
+ * \ingroup TaskUtils
+ */
+unsigned portBASE_TYPE uxTaskGetCpuLoad( unsigned portBASE_TYPE uxWindow );
+
 /**
  * task. h
  * <PRE>void vTaskList( portCHAR *pcWriteBuffer );</PRE>
@@ -1092,6 +1184,13 @@ void vTaskPriorityInherit( xTaskHandle * const pxMutexHolder );
  */
 void vTaskPriorityDisinherit( xTaskHandle * const pxMutexHolder );
 
+/*
+ * Raises the priority of the mutex holder to the ceiling of the mutex it has
+ * just taken, should the holder have a lower priority.  The priority is set
+ * back by vTaskPriorityDisinherit() when the mutex is given.
+ */
+void vTaskPriorityRaiseToCeiling( xTaskHandle * const pxMutexHolder, unsigned portBASE_TYPE uxCeiling );
+
 #ifdef __cplusplus
 }
 #endif
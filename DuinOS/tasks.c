@@ -70,7 +70,12 @@ typedef struct tskTaskControlBlock
 	xListItem				xEventListItem;		/*< List item used to place the TCB in event lists. */
 	unsigned portBASE_TYPE	uxPriority;			/*< The priority of the task where 0 is the lowest priority. */
 	portSTACK_TYPE			*pxStack;			/*< Points to the start of the stack. */
-	signed portCHAR			pcTaskName[ configMAX_TASK_NAME_LEN ];/*< Descriptive name given to the task when created.  Facilitates debugging only. */
+
+	#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+		const signed portCHAR	*pcTaskName;	/*< Descriptive name given to the task when created, held in program memory.  Facilitates debugging only. */
+	#else
+		signed portCHAR			pcTaskName[ configMAX_TASK_NAME_LEN ];/*< Descriptive name given to the task when created.  Facilitates debugging only. */
+	#endif
 
 	#if ( portSTACK_GROWTH > 0 )
 		portSTACK_TYPE *pxEndOfStack;			/*< Used for stack overflow checking on architectures where the stack grows up from low memory. */
@@ -96,8 +101,24 @@ typedef struct tskTaskControlBlock
 		unsigned portLONG ulRunTimeCounter;	 		/*< Used for calculating how much CPU time each task is utilising. */
 	#endif
 
+	#if ( configUSE_STATIC_ALLOCATION == 1 )
+		unsigned portCHAR ucStaticallyAllocated;	/*< pdTRUE if the TCB and stack were supplied to xTaskCreateStatic(), so are not freed. */
+	#endif
+
 } tskTCB;
 
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+	/* xStaticTask in FreeRTOS.h must stay the size of a TCB. */
+	typedef char tskSTATIC_TASK_SIZE_CHECK[ ( sizeof( xStaticTask ) == sizeof( tskTCB ) ) ? 1 : -1 ];
+#endif
+
+/*
+ * Offsets of the two list items within a TCB.  These get back from a list
+ * item to its TCB when configUSE_COMPACT_LIST_ITEMS is 1.
+ */
+#define tskGENERIC_ITEM_OFFSET	offsetof( tskTCB, xGenericListItem )
+#define tskEVENT_ITEM_OFFSET	offsetof( tskTCB, xEventListItem )
+
 /*
  * Some kernel aware debuggers require data to be viewed to be global, rather
  * than file scope.
@@ -137,13 +158,53 @@ static volatile unsigned portBASE_TYPE uxCurrentNumberOfTasks	= ( unsigned portB
 static volatile portTickType xTickCount							= ( portTickType ) 0;
 static unsigned portBASE_TYPE uxTopUsedPriority					= tskIDLE_PRIORITY;
 static volatile unsigned portBASE_TYPE uxTopReadyPriority		= tskIDLE_PRIORITY;
+
+#if ( configUSE_PRIORITY_BITMAP == 1 )
+
+	/* One bit per priority, set when a task is added to the ready list of that
+	priority.  Bits are only cleared by vTaskSwitchContext() when it finds the
+	list empty, so a clear bit always means an empty list, and finding the top
+	ready priority does not depend on configMAX_PRIORITIES, which can be up
+	to 16. */
+	typedef unsigned portSHORT tskReadyBitmap;
+
+	static volatile tskReadyBitmap uxReadyPriorities				= ( tskReadyBitmap ) 0;
+
+	static unsigned portBASE_TYPE prvHighestReadyPriority( void );
+
+#endif
 static volatile signed portBASE_TYPE xSchedulerRunning			= pdFALSE;
 static volatile unsigned portBASE_TYPE uxSchedulerSuspended		= ( unsigned portBASE_TYPE ) pdFALSE;
-static volatile unsigned portBASE_TYPE uxMissedTicks			= ( unsigned portBASE_TYPE ) 0;
+static volatile portTickType xMissedTicks						= ( portTickType ) 0;
 static volatile portBASE_TYPE xMissedYield						= ( portBASE_TYPE ) pdFALSE;
 static volatile portBASE_TYPE xNumOfOverflows					= ( portBASE_TYPE ) 0;
 static unsigned portBASE_TYPE uxTaskNumber 						= ( unsigned portBASE_TYPE ) 0;
 
+#if ( configUSE_CPU_LOAD == 1 )
+
+	/* Idle time is measured with ulPortGetTimestamp() whenever the idle task
+	is switched in or out, and the load is worked out once a second from the
+	tick. */
+	static xTaskHandle xIdleTaskHandle = NULL;
+	static unsigned portLONG ulIdleSwitchedInTime = 0UL;	/*< When the idle task was last switched in. */
+	static unsigned portLONG ulIdleTime = 0UL;				/*< Idle time in the current window. */
+	static unsigned portLONG ulLoadWindowStart = 0UL;		/*< When the current window started. */
+	static portTickType xLoadWindowTicks = ( portTickType ) 0;
+
+	/* The load of each of the last tskCPU_LOAD_HISTORY seconds, in percent,
+	with running sums over the last 10 and 60 of them. */
+	#define tskCPU_LOAD_HISTORY		60
+	static volatile unsigned portCHAR ucCpuLoadHistory[ tskCPU_LOAD_HISTORY ];
+	static volatile unsigned portBASE_TYPE uxCpuLoadNext = 0;		/*< Where the next second goes. */
+	static volatile unsigned portBASE_TYPE uxCpuLoadSeconds = 0;	/*< Seconds held, up to tskCPU_LOAD_HISTORY. */
+	static volatile unsigned portSHORT usCpuLoadSum10 = 0;
+	static volatile unsigned portSHORT usCpuLoadSum60 = 0;
+
+	static void prvUpdateCpuLoad( void );
+	static void prvAdvanceCpuLoadWindow( portTickType xTicks );
+
+#endif
+
 #if ( configGENERATE_RUN_TIME_STATS == 1 )
 
 	static portCHAR pcStatsString[ 50 ];
@@ -168,6 +229,16 @@ static unsigned portBASE_TYPE uxTaskNumber 						= ( unsigned portBASE_TYPE ) 0;
 #define tskDELETED_CHAR		( ( signed portCHAR ) 'D' )
 #define tskSUSPENDED_CHAR	( ( signed portCHAR ) 'S' )
 
+/*
+ * printf conversion used to output a task name.  avr-libc uses %S for strings
+ * held in program memory.
+ */
+#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+	#define tskNAME_FORMAT		"%S"
+#else
+	#define tskNAME_FORMAT		"%s"
+#endif
+
 /*
  * Macros and private variables used by the trace facility.
  */
@@ -229,14 +300,26 @@ static unsigned portBASE_TYPE uxTaskNumber 						= ( unsigned portBASE_TYPE ) 0;
  * executing task, then it will only be rescheduled after the currently
  * executing task has been rescheduled.
  */
-#define prvAddTaskToReadyQueue( pxTCB )																			\
-{																												\
-	if( pxTCB->uxPriority > uxTopReadyPriority )																\
-	{																											\
-		uxTopReadyPriority = pxTCB->uxPriority;																	\
-	}																											\
-	vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) );	\
-}
+#if ( configUSE_PRIORITY_BITMAP == 1 )
+
+	#define prvAddTaskToReadyQueue( pxTCB )																			\
+	{																												\
+		uxReadyPriorities |= ( tskReadyBitmap ) ( ( tskReadyBitmap ) 1U << pxTCB->uxPriority );					\
+		vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) );	\
+	}
+
+#else
+
+	#define prvAddTaskToReadyQueue( pxTCB )																			\
+	{																												\
+		if( pxTCB->uxPriority > uxTopReadyPriority )																\
+		{																											\
+			uxTopReadyPriority = pxTCB->uxPriority;																	\
+		}																											\
+		vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) );	\
+	}
+
+#endif
 /*-----------------------------------------------------------*/
 
 /*
@@ -251,7 +334,7 @@ static unsigned portBASE_TYPE uxTaskNumber 						= ( unsigned portBASE_TYPE ) 0;
 {																													\
 register tskTCB *pxTCB;																								\
 																													\
-	while( ( pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxDelayedTaskList ) ) != NULL )						\
+	while( ( pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY_AT( pxDelayedTaskList, tskGENERIC_ITEM_OFFSET ) ) != NULL )						\
 	{																												\
 		if( xTickCount < listGET_LIST_ITEM_VALUE( &( pxTCB->xGenericListItem ) ) )									\
 		{																											\
@@ -324,12 +407,27 @@ static portTASK_FUNCTION_PROTO( prvIdleTask, pvParameters );
  */
 static void prvCheckTasksWaitingTermination( void );
 
+/*
+ * Called by xTaskResumeAll() to process the ticks that were missed while the
+ * scheduler was suspended.  The tick count is moved on by all of them at
+ * once, and the delayed list is walked once, instead of replaying each tick
+ * through vTaskIncrementTick().
+ */
+static void prvCatchUpTicks( portTickType xTicks );
+
 /*
  * Allocates memory from the heap for a TCB and associated stack.  Checks the
  * allocation was successful.
  */
 static tskTCB *prvAllocateTCBAndStack( unsigned portSHORT usStackDepth );
 
+/*
+ * Creates a task in a TCB and stack from prvAllocateTCBAndStack() or
+ * supplied to xTaskCreateStatic().  pxNewTCB is NULL if the allocation
+ * failed.
+ */
+static signed portBASE_TYPE prvCreateTask( tskTCB *pxNewTCB, pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask );
+
 /*
  * Called from vTaskList.  vListTasks details all the tasks currently under
  * control of the scheduler.  The tasks may be in one of a number of lists.
@@ -367,12 +465,33 @@ static tskTCB *prvAllocateTCBAndStack( unsigned portSHORT usStackDepth );
 
 signed portBASE_TYPE xTaskCreate( pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask )
 {
-signed portBASE_TYPE xReturn;
-tskTCB * pxNewTCB;
-
 	/* Allocate the memory required by the TCB and stack for the new task.
-	checking that the allocation was successful. */
-	pxNewTCB = prvAllocateTCBAndStack( usStackDepth );
+	prvCreateTask() checks that the allocation was successful. */
+	return prvCreateTask( prvAllocateTCBAndStack( usStackDepth ), pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask );
+}
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_STATIC_ALLOCATION == 1 )
+
+	signed portBASE_TYPE xTaskCreateStatic( pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask, portSTACK_TYPE *puxStackBuffer, xStaticTask *pxTaskBuffer )
+	{
+	tskTCB *pxNewTCB = ( tskTCB * ) pxTaskBuffer;
+
+		pxNewTCB->pxStack = puxStackBuffer;
+		pxNewTCB->ucStaticallyAllocated = pdTRUE;
+
+		/* Just to help debugging, as for the heap allocated stacks. */
+		memset( pxNewTCB->pxStack, tskSTACK_FILL_BYTE, usStackDepth * sizeof( portSTACK_TYPE ) );
+
+		return prvCreateTask( pxNewTCB, pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask );
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+static signed portBASE_TYPE prvCreateTask( tskTCB *pxNewTCB, pdTASK_CODE pvTaskCode, const signed portCHAR * const pcName, unsigned portSHORT usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask )
+{
+signed portBASE_TYPE xReturn;
 
 	if( pxNewTCB != NULL )
 	{
@@ -981,7 +1100,16 @@ void vTaskStartScheduler( void )
 portBASE_TYPE xReturn;
 
 	/* Add the idle task at the lowest priority. */
-	xReturn = xTaskCreate( prvIdleTask, ( signed portCHAR * ) "IDLE", tskIDLE_STACK_SIZE, ( void * ) NULL, tskIDLE_PRIORITY, ( xTaskHandle * ) NULL );
+	#if ( configUSE_CPU_LOAD == 1 )
+	{
+		/* The load meter needs to know which task is the idle task. */
+		xReturn = xTaskCreate( prvIdleTask, tskTASK_NAME( "IDLE" ), tskIDLE_STACK_SIZE, ( void * ) NULL, tskIDLE_PRIORITY, &xIdleTaskHandle );
+	}
+	#else
+	{
+		xReturn = xTaskCreate( prvIdleTask, tskTASK_NAME( "IDLE" ), tskIDLE_STACK_SIZE, ( void * ) NULL, tskIDLE_PRIORITY, ( xTaskHandle * ) NULL );
+	}
+	#endif
 
 	if( xReturn == pdPASS )
 	{
@@ -1003,6 +1131,13 @@ portBASE_TYPE xReturn;
 		the run time counter time base. */
 		portCONFIGURE_TIMER_FOR_RUN_TIME_STATS();
 
+		#if ( configUSE_CPU_LOAD == 1 )
+		{
+			ulLoadWindowStart = ulPortGetTimestamp();
+			ulIdleSwitchedInTime = ulLoadWindowStart;
+		}
+		#endif
+
 		/* Setting up the timer tick is hardware specific and thus in the
 		portable interface. */
 		if( xPortStartScheduler() )
@@ -1059,7 +1194,7 @@ signed portBASE_TYPE xAlreadyYielded = pdFALSE;
 
 				/* Move any readied tasks from the pending list into the
 				appropriate ready list. */
-				while( ( pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY(  ( ( xList * ) &xPendingReadyList ) ) ) != NULL )
+				while( ( pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY_AT( ( ( xList * ) &xPendingReadyList ), tskEVENT_ITEM_OFFSET ) ) != NULL )
 				{
 					vListRemove( &( pxTCB->xEventListItem ) );
 					vListRemove( &( pxTCB->xGenericListItem ) );
@@ -1076,13 +1211,10 @@ signed portBASE_TYPE xAlreadyYielded = pdFALSE;
 				/* If any ticks occurred while the scheduler was suspended then
 				they should be processed now.  This ensures the tick count does not
 				slip, and that any delayed tasks are resumed at the correct time. */
-				if( uxMissedTicks > ( unsigned portBASE_TYPE ) 0 )
+				if( xMissedTicks > ( portTickType ) 0 )
 				{
-					while( uxMissedTicks > ( unsigned portBASE_TYPE ) 0 )
-					{
-						vTaskIncrementTick();
-						--uxMissedTicks;
-					}
+					prvCatchUpTicks( xMissedTicks );
+					xMissedTicks = ( portTickType ) 0;
 
 					/* As we have processed some ticks it is appropriate to yield
 					to ensure the highest priority task that is ready to run is
@@ -1335,10 +1467,16 @@ void vTaskIncrementTick( void )
 
 		/* See if this tick has made a timeout expire. */
 		prvCheckDelayedTasks();
+
+		#if ( configUSE_CPU_LOAD == 1 )
+		{
+			prvAdvanceCpuLoadWindow( ( portTickType ) 1 );
+		}
+		#endif
 	}
 	else
 	{
-		++uxMissedTicks;
+		++xMissedTicks;
 
 		/* The tick hook gets called at regular intervals, even if the
 		scheduler is locked. */
@@ -1357,7 +1495,7 @@ void vTaskIncrementTick( void )
 
 		/* Guard against the tick hook being called when the missed tick
 		count is being unwound (when the scheduler is being unlocked. */
-		if( uxMissedTicks == 0 )
+		if( xMissedTicks == 0 )
 		{
 			vApplicationTickHook();
 		}
@@ -1368,6 +1506,41 @@ void vTaskIncrementTick( void )
 }
 /*-----------------------------------------------------------*/
 
+static void prvCatchUpTicks( portTickType xTicks )
+{
+portTickType xNewTickCount = xTickCount + xTicks;
+
+	if( xNewTickCount < xTickCount )
+	{
+		xList *pxTemp;
+
+		/* The tick count overflows on the way, so every task in the current
+		delayed list is due.  Wake them all before swapping the lists, as
+		vTaskIncrementTick() would have done on the way to the overflow. */
+		xTickCount = portMAX_DELAY;
+		prvCheckDelayedTasks();
+
+		pxTemp = pxDelayedTaskList;
+		pxDelayedTaskList = pxOverflowDelayedTaskList;
+		pxOverflowDelayedTaskList = pxTemp;
+		xNumOfOverflows++;
+	}
+
+	/* The delayed list is ordered by wake time, so one pass wakes every task
+	that became due during the missed ticks. */
+	xTickCount = xNewTickCount;
+	prvCheckDelayedTasks();
+
+	#if ( configUSE_CPU_LOAD == 1 )
+	{
+		prvAdvanceCpuLoadWindow( xTicks );
+	}
+	#endif
+
+	traceTASK_INCREMENT_TICK( xTickCount );
+}
+/*-----------------------------------------------------------*/
+
 #if ( ( INCLUDE_vTaskCleanUpResources == 1 ) && ( INCLUDE_vTaskSuspend == 1 ) )
 
 	void vTaskCleanUpResources( void )
@@ -1384,7 +1557,7 @@ void vTaskIncrementTick( void )
 
 			while( !listLIST_IS_EMPTY( &( pxReadyTasksLists[ usQueue ] ) ) )
 			{
-				listGET_OWNER_OF_NEXT_ENTRY( pxTCB, &( pxReadyTasksLists[ usQueue ] ) );
+				listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, &( pxReadyTasksLists[ usQueue ] ), tskGENERIC_ITEM_OFFSET );
 				vListRemove( ( xListItem * ) &( pxTCB->xGenericListItem ) );
 
 				prvDeleteTCB( ( tskTCB * ) pxTCB );
@@ -1394,7 +1567,7 @@ void vTaskIncrementTick( void )
 		/* Remove any TCB's from the delayed queue. */
 		while( !listLIST_IS_EMPTY( &xDelayedTaskList1 ) )
 		{
-			listGET_OWNER_OF_NEXT_ENTRY( pxTCB, &xDelayedTaskList1 );
+			listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, &xDelayedTaskList1, tskGENERIC_ITEM_OFFSET );
 			vListRemove( ( xListItem * ) &( pxTCB->xGenericListItem ) );
 
 			prvDeleteTCB( ( tskTCB * ) pxTCB );
@@ -1403,7 +1576,7 @@ void vTaskIncrementTick( void )
 		/* Remove any TCB's from the overflow delayed queue. */
 		while( !listLIST_IS_EMPTY( &xDelayedTaskList2 ) )
 		{
-			listGET_OWNER_OF_NEXT_ENTRY( pxTCB, &xDelayedTaskList2 );
+			listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, &xDelayedTaskList2, tskGENERIC_ITEM_OFFSET );
 			vListRemove( ( xListItem * ) &( pxTCB->xGenericListItem ) );
 
 			prvDeleteTCB( ( tskTCB * ) pxTCB );
@@ -1411,7 +1584,7 @@ void vTaskIncrementTick( void )
 
 		while( !listLIST_IS_EMPTY( &xSuspendedTaskList ) )
 		{
-			listGET_OWNER_OF_NEXT_ENTRY( pxTCB, &xSuspendedTaskList );
+			listGET_OWNER_OF_NEXT_ENTRY_AT( pxTCB, &xSuspendedTaskList, tskGENERIC_ITEM_OFFSET );
 			vListRemove( ( xListItem * ) &( pxTCB->xGenericListItem ) );
 
 			prvDeleteTCB( ( tskTCB * ) pxTCB );
@@ -1510,6 +1683,10 @@ void vTaskIncrementTick( void )
 
 void vTaskSwitchContext( void )
 {
+#if ( configUSE_CPU_LOAD == 1 )
+	tskTCB * const pxPreviousTCB = ( tskTCB * ) pxCurrentTCB;
+#endif
+
 	if( uxSchedulerSuspended != ( unsigned portBASE_TYPE ) pdFALSE )
 	{
 		/* The scheduler is currently suspended - do not allow a context
@@ -1538,20 +1715,233 @@ void vTaskSwitchContext( void )
 	taskSECOND_CHECK_FOR_STACK_OVERFLOW();
 
 	/* Find the highest priority queue that contains ready tasks. */
-	while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )
+	#if ( configUSE_PRIORITY_BITMAP == 1 )
 	{
-		--uxTopReadyPriority;
+		uxTopReadyPriority = prvHighestReadyPriority();
+		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )
+		{
+			/* The last task of that priority has left the ready list since
+			the bit was set.  The idle task is always ready, so this ends. */
+			uxReadyPriorities &= ( tskReadyBitmap ) ~( ( tskReadyBitmap ) 1U << uxTopReadyPriority );
+			uxTopReadyPriority = prvHighestReadyPriority();
+		}
+	}
+	#else
+	{
+		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )
+		{
+			--uxTopReadyPriority;
+		}
 	}
+	#endif
 
 	/* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the
 	same priority get an equal share of the processor time. */
-	listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ) );
+	listGET_OWNER_OF_NEXT_ENTRY_AT( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ), tskGENERIC_ITEM_OFFSET );
+
+	#if ( configUSE_CPU_LOAD == 1 )
+	{
+		/* Only switches to and from the idle task are timed. */
+		if( ( pxPreviousTCB == ( tskTCB * ) xIdleTaskHandle ) || ( pxCurrentTCB == ( tskTCB * ) xIdleTaskHandle ) )
+		{
+		unsigned portLONG ulNow = ulPortGetTimestamp();
+
+			if( pxPreviousTCB == ( tskTCB * ) xIdleTaskHandle )
+			{
+				ulIdleTime += ulNow - ulIdleSwitchedInTime;
+			}
+			ulIdleSwitchedInTime = ulNow;
+		}
+	}
+	#endif
 
 	traceTASK_SWITCHED_IN();
 	vWriteTraceToBuffer();
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_PRIORITY_BITMAP == 1 )
+
+	/*
+	 * Highest bit set in uxReadyPriorities, found by halving the bitmap
+	 * rather than by walking down the priorities.
+	 */
+	static unsigned portBASE_TYPE prvHighestReadyPriority( void )
+	{
+	tskReadyBitmap uxBits = uxReadyPriorities;
+	unsigned portBASE_TYPE uxPriority = ( unsigned portBASE_TYPE ) 0;
+
+		if( uxBits & ( tskReadyBitmap ) 0xff00U )
+		{
+			uxBits >>= 8;
+			uxPriority += ( unsigned portBASE_TYPE ) 8;
+		}
+
+		if( uxBits & ( tskReadyBitmap ) 0xf0U )
+		{
+			uxBits >>= 4;
+			uxPriority += ( unsigned portBASE_TYPE ) 4;
+		}
+
+		if( uxBits & ( tskReadyBitmap ) 0x0cU )
+		{
+			uxBits >>= 2;
+			uxPriority += ( unsigned portBASE_TYPE ) 2;
+		}
+
+		if( uxBits & ( tskReadyBitmap ) 0x02U )
+		{
+			uxPriority += ( unsigned portBASE_TYPE ) 1;
+		}
+
+		return uxPriority;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_CPU_LOAD == 1 )
+
+	/*
+	 * Counts the ticks of the current window, closing it once a second.
+	 * Ticks caught up after the scheduler was suspended may close a longer
+	 * window, the load is worked out from the time it actually lasted.
+	 */
+	static void prvAdvanceCpuLoadWindow( portTickType xTicks )
+	{
+	unsigned portLONG ulTicks = ( unsigned portLONG ) xLoadWindowTicks + xTicks;
+
+		if( ulTicks >= ( unsigned portLONG ) configTICK_RATE_HZ )
+		{
+			ulTicks %= ( unsigned portLONG ) configTICK_RATE_HZ;
+			prvUpdateCpuLoad();
+		}
+
+		xLoadWindowTicks = ( portTickType ) ulTicks;
+	}
+
+	/*
+	 * Called from the tick, once a second, to close the current window and
+	 * add its load to the history.
+	 */
+	static void prvUpdateCpuLoad( void )
+	{
+	unsigned portLONG ulNow, ulTotal;
+	unsigned portSHORT usLoad;
+	unsigned portBASE_TYPE uxOldest;
+
+		ulNow = ulPortGetTimestamp();
+
+		/* The tick may have interrupted the idle task. */
+		if( pxCurrentTCB == ( tskTCB * ) xIdleTaskHandle )
+		{
+			ulIdleTime += ulNow - ulIdleSwitchedInTime;
+			ulIdleSwitchedInTime = ulNow;
+		}
+
+		ulTotal = ulNow - ulLoadWindowStart;
+		if( ulIdleTime > ulTotal )
+		{
+			ulIdleTime = ulTotal;
+		}
+
+		/* Work in 1/256ths of a percent, scaling the total down rather than
+		the busy time up so that nothing overflows. */
+		ulTotal = ( ulTotal + 128UL ) >> 8;
+		if( ulTotal == 0UL )
+		{
+			ulTotal = 1UL;
+		}
+		usLoad = ( unsigned portSHORT ) ( ( ( ( ulNow - ulLoadWindowStart ) - ulIdleTime ) * 100UL ) / ulTotal );
+		if( usLoad > ( unsigned portSHORT ) ( 100U << 8 ) )
+		{
+			usLoad = ( unsigned portSHORT ) ( 100U << 8 );
+		}
+
+		/* Rounded to whole percent, the sums of 60 of them fit 16 bits. */
+		usLoad = ( usLoad + 128U ) >> 8;
+
+		/* The second that leaves the 10 second window is the one 10 places
+		back, the one that leaves the 60 second window is overwritten. */
+		if( uxCpuLoadSeconds >= ( unsigned portBASE_TYPE ) 10 )
+		{
+			uxOldest = uxCpuLoadNext + ( unsigned portBASE_TYPE ) ( tskCPU_LOAD_HISTORY - 10 );
+			if( uxOldest >= ( unsigned portBASE_TYPE ) tskCPU_LOAD_HISTORY )
+			{
+				uxOldest -= ( unsigned portBASE_TYPE ) tskCPU_LOAD_HISTORY;
+			}
+			usCpuLoadSum10 -= ucCpuLoadHistory[ uxOldest ];
+		}
+		if( uxCpuLoadSeconds >= ( unsigned portBASE_TYPE ) tskCPU_LOAD_HISTORY )
+		{
+			usCpuLoadSum60 -= ucCpuLoadHistory[ uxCpuLoadNext ];
+		}
+		else
+		{
+			uxCpuLoadSeconds++;
+		}
+
+		ucCpuLoadHistory[ uxCpuLoadNext ] = ( unsigned portCHAR ) usLoad;
+		usCpuLoadSum10 += usLoad;
+		usCpuLoadSum60 += usLoad;
+		if( ++uxCpuLoadNext >= ( unsigned portBASE_TYPE ) tskCPU_LOAD_HISTORY )
+		{
+			uxCpuLoadNext = 0;
+		}
+
+		ulLoadWindowStart = ulNow;
+		ulIdleTime = 0UL;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_CPU_LOAD == 1 )
+
+	unsigned portBASE_TYPE uxTaskGetCpuLoad( unsigned portBASE_TYPE uxWindow )
+	{
+	unsigned portSHORT usSum;
+	unsigned portBASE_TYPE uxSeconds, uxLast;
+
+		portENTER_CRITICAL();
+		{
+			uxSeconds = uxCpuLoadSeconds;
+			if( uxWindow == tskCPU_LOAD_10S )
+			{
+				usSum = usCpuLoadSum10;
+				if( uxSeconds > ( unsigned portBASE_TYPE ) 10 )
+				{
+					uxSeconds = ( unsigned portBASE_TYPE ) 10;
+				}
+			}
+			else if( uxWindow == tskCPU_LOAD_60S )
+			{
+				usSum = usCpuLoadSum60;
+			}
+			else
+			{
+				uxLast = ( uxCpuLoadNext == 0 ) ? ( unsigned portBASE_TYPE ) ( tskCPU_LOAD_HISTORY - 1 ) : uxCpuLoadNext - 1;
+				usSum = ucCpuLoadHistory[ uxLast ];
+				if( uxSeconds > ( unsigned portBASE_TYPE ) 1 )
+				{
+					uxSeconds = ( unsigned portBASE_TYPE ) 1;
+				}
+			}
+		}
+		portEXIT_CRITICAL();
+
+		if( uxSeconds == 0 )
+		{
+			return ( unsigned portBASE_TYPE ) 0;
+		}
+
+		/* Rounded to whole percent. */
+		return ( unsigned portBASE_TYPE ) ( ( usSum + ( uxSeconds >> 1 ) ) / uxSeconds );
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 void vTaskPlaceOnEventList( const xList * const pxEventList, portTickType xTicksToWait )
 {
 portTickType xTimeToWake;
@@ -1637,7 +2027,7 @@ portBASE_TYPE xReturn;
 	If an event is for a queue that is locked then this function will never
 	get called - the lock count on the queue will get modified instead.  This
 	means we can always expect exclusive access to the event list here. */
-	pxUnblockedTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxEventList );
+	pxUnblockedTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY_AT( pxEventList, tskEVENT_ITEM_OFFSET );
 	vListRemove( &( pxUnblockedTCB->xEventListItem ) );
 
 	if( uxSchedulerSuspended == ( unsigned portBASE_TYPE ) pdFALSE )
@@ -1803,13 +2193,23 @@ static portTASK_FUNCTION( prvIdleTask, pvParameters )
 static void prvInitialiseTCBVariables( tskTCB *pxTCB, const signed portCHAR * const pcName, unsigned portBASE_TYPE uxPriority )
 {
 	/* Store the function name in the TCB. */
-	#if configMAX_TASK_NAME_LEN > 1
+	#if ( configUSE_PROGMEM_TASK_NAMES == 1 )
+	{
+		/* The name lives in program memory for the life of the task, so only
+		the pointer needs to be kept. */
+		pxTCB->pcTaskName = pcName;
+	}
+	#else
 	{
-		/* Don't bring strncpy into the build unnecessarily. */
-		strncpy( ( char * ) pxTCB->pcTaskName, ( const char * ) pcName, ( unsigned portSHORT ) configMAX_TASK_NAME_LEN );
+		#if configMAX_TASK_NAME_LEN > 1
+		{
+			/* Don't bring strncpy into the build unnecessarily. */
+			strncpy( ( char * ) pxTCB->pcTaskName, ( const char * ) pcName, ( unsigned portSHORT ) configMAX_TASK_NAME_LEN );
+		}
+		#endif
+		pxTCB->pcTaskName[ ( unsigned portSHORT ) configMAX_TASK_NAME_LEN - ( unsigned portSHORT ) 1 ] = '\0';
 	}
 	#endif
-	pxTCB->pcTaskName[ ( unsigned portSHORT ) configMAX_TASK_NAME_LEN - ( unsigned portSHORT ) 1 ] = '\0';
 
 	/* This is used as an array index so must ensure it's not too large. */
 	if( uxPriority >= configMAX_PRIORITIES )
@@ -1907,7 +2307,7 @@ static void prvCheckTasksWaitingTermination( void )
 
 				portENTER_CRITICAL();
 				{
-					pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( ( ( xList * ) &xTasksWaitingTermination ) );
+					pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY_AT( ( ( xList * ) &xTasksWaitingTermination ), tskGENERIC_ITEM_OFFSET );
 					vListRemove( &( pxTCB->xGenericListItem ) );
 					--uxCurrentNumberOfTasks;
 					--uxTasksDeleted;
@@ -1947,6 +2347,12 @@ tskTCB *pxNewTCB;
 		{
 			/* Just to help debugging. */
 			memset( pxNewTCB->pxStack, tskSTACK_FILL_BYTE, usStackDepth * sizeof( portSTACK_TYPE ) );
+
+			#if ( configUSE_STATIC_ALLOCATION == 1 )
+			{
+				pxNewTCB->ucStaticallyAllocated = pdFALSE;
+			}
+			#endif
 		}
 	}
 
@@ -1962,12 +2368,12 @@ tskTCB *pxNewTCB;
 	unsigned portSHORT usStackRemaining;
 
 		/* Write the details of all the TCB's in pxList into the buffer. */
-		listGET_OWNER_OF_NEXT_ENTRY( pxFirstTCB, pxList );
+		listGET_OWNER_OF_NEXT_ENTRY_AT( pxFirstTCB, pxList, tskGENERIC_ITEM_OFFSET );
 		do
 		{
-			listGET_OWNER_OF_NEXT_ENTRY( pxNextTCB, pxList );
+			listGET_OWNER_OF_NEXT_ENTRY_AT( pxNextTCB, pxList, tskGENERIC_ITEM_OFFSET );
 			usStackRemaining = usTaskCheckFreeStackSpace( ( unsigned portCHAR * ) pxNextTCB->pxStack );
-			sprintf( pcStatusString, ( portCHAR * ) "%s\t\t%c\t%u\t%u\t%u\r\n", pxNextTCB->pcTaskName, cStatus, ( unsigned int ) pxNextTCB->uxPriority, usStackRemaining, ( unsigned int ) pxNextTCB->uxTCBNumber );
+			sprintf( pcStatusString, ( portCHAR * ) tskNAME_FORMAT "\t\t%c\t%u\t%u\t%u\r\n", pxNextTCB->pcTaskName, cStatus, ( unsigned int ) pxNextTCB->uxPriority, usStackRemaining, ( unsigned int ) pxNextTCB->uxTCBNumber );
 			strcat( ( portCHAR * ) pcWriteBuffer, ( portCHAR * ) pcStatusString );
 
 		} while( pxNextTCB != pxFirstTCB );
@@ -1984,11 +2390,11 @@ tskTCB *pxNewTCB;
 	unsigned portLONG ulStatsAsPercentage;
 
 		/* Write the run time stats of all the TCB's in pxList into the buffer. */
-		listGET_OWNER_OF_NEXT_ENTRY( pxFirstTCB, pxList );
+		listGET_OWNER_OF_NEXT_ENTRY_AT( pxFirstTCB, pxList, tskGENERIC_ITEM_OFFSET );
 		do
 		{
 			/* Get next TCB in from the list. */
-			listGET_OWNER_OF_NEXT_ENTRY( pxNextTCB, pxList );
+			listGET_OWNER_OF_NEXT_ENTRY_AT( pxNextTCB, pxList, tskGENERIC_ITEM_OFFSET );
 
 			/* Divide by zero check. */
 			if( ulTotalRunTime > 0UL )
@@ -1997,7 +2403,7 @@ tskTCB *pxNewTCB;
 				if( pxNextTCB->ulRunTimeCounter == 0 )
 				{
 					/* The task has used no CPU time at all. */
-					sprintf( pcStatsString, ( portCHAR * ) "%s\t\t0\t\t0%%\r\n", pxNextTCB->pcTaskName );
+					sprintf( pcStatsString, ( portCHAR * ) tskNAME_FORMAT "\t\t0\t\t0%%\r\n", pxNextTCB->pcTaskName );
 				}
 				else
 				{
@@ -2007,13 +2413,13 @@ tskTCB *pxNewTCB;
 
 					if( ulStatsAsPercentage > 0UL )
 					{
-						sprintf( pcStatsString, ( portCHAR * ) "%s\t\t%u\t\t%u%%\r\n", pxNextTCB->pcTaskName, ( unsigned int ) pxNextTCB->ulRunTimeCounter, ( unsigned int ) ulStatsAsPercentage );
+						sprintf( pcStatsString, ( portCHAR * ) tskNAME_FORMAT "\t\t%u\t\t%u%%\r\n", pxNextTCB->pcTaskName, ( unsigned int ) pxNextTCB->ulRunTimeCounter, ( unsigned int ) ulStatsAsPercentage );
 					}
 					else
 					{
 						/* If the percentage is zero here then the task has
 						consumed less than 1% of the total run time. */
-						sprintf( pcStatsString, ( portCHAR * ) "%s\t\t%u\t\t<1%%\r\n", pxNextTCB->pcTaskName, ( unsigned int ) pxNextTCB->ulRunTimeCounter );
+						sprintf( pcStatsString, ( portCHAR * ) tskNAME_FORMAT "\t\t%u\t\t<1%%\r\n", pxNextTCB->pcTaskName, ( unsigned int ) pxNextTCB->ulRunTimeCounter );
 					}
 				}
 
@@ -2075,6 +2481,16 @@ tskTCB *pxNewTCB;
 
 	static void prvDeleteTCB( tskTCB *pxTCB )
 	{
+		#if ( configUSE_STATIC_ALLOCATION == 1 )
+		{
+			/* The application owns the memory of a static task. */
+			if( pxTCB->ucStaticallyAllocated != pdFALSE )
+			{
+				return;
+			}
+		}
+		#endif
+
 		/* Free up the memory allocated by the scheduler for the task.  It is up to
 		the task to free any memory allocated at the application level. */
 		vPortFree( pxTCB->pxStack );
@@ -2186,6 +2602,32 @@ tskTCB *pxNewTCB;
 #endif
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_MUTEX_PRIORITY_CEILING == 1 )
+
+	void vTaskPriorityRaiseToCeiling( xTaskHandle * const pxMutexHolder, unsigned portBASE_TYPE uxCeiling )
+	{
+	tskTCB * const pxTCB = ( tskTCB * ) pxMutexHolder;
+
+		if( uxCeiling >= configMAX_PRIORITIES )
+		{
+			uxCeiling = configMAX_PRIORITIES - ( unsigned portBASE_TYPE ) 1U;
+		}
+
+		if( pxTCB->uxPriority < uxCeiling )
+		{
+			/* The holder is the task that has just taken the mutex, so it is
+			running and is in the ready list of its current priority. */
+			vListRemove( &( pxTCB->xGenericListItem ) );
+
+			pxTCB->uxPriority = uxCeiling;
+			listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), configMAX_PRIORITIES - ( portTickType ) pxTCB->uxPriority );
+			prvAddTaskToReadyQueue( pxTCB );
+		}
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 #if ( portCRITICAL_NESTING_IN_TCB == 1 )
 
 	void vTaskEnterCritical( void )
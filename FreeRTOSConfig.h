@@ -52,7 +52,9 @@
 #ifndef FREERTOS_CONFIG_H
 #define FREERTOS_CONFIG_H
 
-#include <avr/io.h>
+#ifndef DUINOS_POSIX_PORT
+	#include <avr/io.h>
+#endif
 
 /*-----------------------------------------------------------
  * Application specific definitions.
@@ -67,7 +69,9 @@
  *----------------------------------------------------------*/
 
 // XXX: rsanders testing
-#define portBYTE_ALIGNMENT 1
+#ifndef DUINOS_POSIX_PORT
+	#define portBYTE_ALIGNMENT 1
+#endif
 #define DUINOS_USE_HEAP2 1
 
 #ifndef FREERTOS_ARDUINO
@@ -97,7 +101,16 @@
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	//##Mutexes use priority inheritance, or the priority ceiling protocol when
+	//##created with xSemaphoreCreateCeilingMutex():
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	//##Idle time accounting for uxTaskGetCpuLoad():
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	//##Tasks and queues in static storage (xTaskCreateStatic(), the C++ templates of
+	//##DuinOS/static_rtos.h). Costs one byte per task:
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	//##2009.10.20: defined as "0":
@@ -127,8 +140,10 @@
 	//#define configCPU_CLOCK_HZ			( ( unsigned portLONG ) 18432000 )
 
 	#define configTICK_RATE_HZ			( ( portTickType ) 1000 )
-	//##For these big cpus, it's possible to define more priorities if necessary:
-	#define configMAX_PRIORITIES		( ( unsigned portBASE_TYPE ) 3 )
+	//##Up to 16 priorities, with the named bands of DuinOS.h. Keep it a plain number, it is
+	//##tested with #if:
+	#define configMAX_PRIORITIES		( 16 )
+	#define configUSE_PRIORITY_BITMAP	1
 	#define configMINIMAL_STACK_SIZE	( ( unsigned portSHORT ) 85 )
 	//##Run experiments to test this value:
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 4096 ) )
@@ -137,7 +152,11 @@
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	//##2009.10.20: defined as "0":
@@ -167,8 +186,10 @@
 	//#define configCPU_CLOCK_HZ			( ( unsigned portLONG ) 16000000 )
 
 	#define configTICK_RATE_HZ			( ( portTickType ) 1000 )
-	//##For these bigger cpus, it's possible to define more priorities if necessary:
-	#define configMAX_PRIORITIES		( ( unsigned portBASE_TYPE ) 3 )
+	//##Up to 16 priorities, with the named bands of DuinOS.h. Keep it a plain number, it is
+	//##tested with #if:
+	#define configMAX_PRIORITIES		( 16 )
+	#define configUSE_PRIORITY_BITMAP	1
 	#define configMINIMAL_STACK_SIZE	( ( unsigned portSHORT ) 85 )
 	//##Run experiments to test this value:
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 4096 ) )
@@ -177,7 +198,11 @@
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	//##2009.10.20: defined as "0":
@@ -210,10 +235,18 @@
 	#define configMINIMAL_STACK_SIZE	( ( unsigned portSHORT ) 85 )
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 1200 ) )
 	#define configMAX_TASK_NAME_LEN		( 16 )
+	//##Small RAM: keep task names in flash, the TCB only holds a pointer:
+	#define configUSE_PROGMEM_TASK_NAMES	1
+	//##Small RAM: list items find their TCB by offset instead of an owner pointer:
+	#define configUSE_COMPACT_LIST_ITEMS	1
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	#define configUSE_CO_ROUTINES 		0
@@ -240,15 +273,48 @@
 	#define configCPU_CLOCK_HZ			( ( unsigned portLONG ) F_CPU )
 
 	#define configTICK_RATE_HZ			( ( portTickType ) 1000 )
-	//##For these bigger cpus, it's possible to define more priorities if necessary:
-	#define configMAX_PRIORITIES		( ( unsigned portBASE_TYPE ) 3 )
+	//##The tick is the Timer 0 overflow of the core (about 976 Hz) unless another source is
+	//##chosen. Timer 3 gives exactly configTICK_RATE_HZ, but is lost to analogWrite() (see
+	//##configTICK_SOURCE in DuinOS/portmacro.h):
+	//#define configTICK_SOURCE			portTICK_SOURCE_TIMER3
+	//##Up to 16 priorities, with the named bands of DuinOS.h. Keep it a plain number, it is
+	//##tested with #if:
+	#define configMAX_PRIORITIES		( 16 )
+	#define configUSE_PRIORITY_BITMAP	1
 	#define configMINIMAL_STACK_SIZE	( ( unsigned portSHORT ) 85 )
+	//##Options below that keep their data in .bss (configUSB_TX_RING_SIZE, the static
+	//##USB semaphores and event queue) need this lowered by as much:
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 7200 ) )
 	#define configMAX_TASK_NAME_LEN		( 16 )
+	//##Deferred interrupt work (DuinOS/pendcall.h). Adds a task at the top priority,
+	//##and also moves the USB control requests out of the USB_COM interrupt:
+	#define configUSE_PEND_CALL_TASK	0
+	//##Event driven state machines sharing tasks (DuinOS/active.h):
+	#define configUSE_ACTIVE_OBJECTS	1
+	//##Serial.write() copies into a RAM ring that the USB interrupts send (see
+	//##usb_private.h), instead of waiting for the endpoint. 256 is a good size, less
+	//##the same from configTOTAL_HEAP_SIZE:
+	#define configUSB_TX_RING_SIZE		0
+	//##A vendor bulk interface next to the serial port, for libusb (the Vendor object
+	//##of usb_api.h). Makes the board a composite device:
+	#define configUSB_VENDOR_BULK		0
+	//##millis() and micros() follow the host's USB frame clock, and usbHostMicros()
+	//##timestamps line up between boards (see usb_private.h):
+	#define configUSB_SOF_TIMEBASE		0
+	//##Connection changes (configured, suspend, DTR, baud...) queued for a task in
+	//##Serial.waitEvent(). 8 is plenty:
+	#define configUSB_EVENT_QUEUE_LENGTH	0
+	//##Power down while the host suspends the bus, parking the tasks given to
+	//##Serial.parkOnSuspend(). Stops millis() and every task until resume:
+	#define configUSB_SUSPEND_POWER_DOWN	0
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	#define configUSE_CO_ROUTINES 		0
@@ -282,10 +348,18 @@
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 1200 ) )
 	//#define configMAX_TASK_NAME_LEN		( 8 )
 	#define configMAX_TASK_NAME_LEN		( 16 )
+	//##Small RAM: keep task names in flash, the TCB only holds a pointer:
+	#define configUSE_PROGMEM_TASK_NAMES	1
+	//##Small RAM: list items find their TCB by offset instead of an owner pointer:
+	#define configUSE_COMPACT_LIST_ITEMS	1
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
 	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
 
 	/* Co-routine definitions. */
 	//##2009.10.20: defined as "0":
@@ -320,9 +394,16 @@
 	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 800 ) )
 	//#define configMAX_TASK_NAME_LEN		( 8 )
 	#define configMAX_TASK_NAME_LEN		( 16 )
+	//##Small RAM: keep task names in flash, the TCB only holds a pointer:
+	#define configUSE_PROGMEM_TASK_NAMES	1
+	//##Small RAM: list items find their TCB by offset instead of an owner pointer:
+	#define configUSE_COMPACT_LIST_ITEMS	1
 	#define configUSE_TRACE_FACILITY	0
 	#define configUSE_16_BIT_TICKS		1
 	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	0
+	#define configUSE_CPU_LOAD			0
 	#define configQUEUE_REGISTRY_SIZE	0
 
 	/* Co-routine definitions. */
@@ -340,6 +421,49 @@
 	#define INCLUDE_vTaskDelayUntil			1
 	#define INCLUDE_vTaskDelay				1
 
+#elif defined(DUINOS_POSIX_PORT)
+	//##Host (Linux) port, see DuinOS/posix. Mirrors the AVR profiles, but
+	//##with room for stress tests:
+
+	#define configUSE_PREEMPTION		1
+	#define configUSE_IDLE_HOOK			0
+	#define configUSE_TICK_HOOK			0
+
+	//##Not used by the host port, the tick comes from an interval timer:
+	#define configCPU_CLOCK_HZ			( ( unsigned portLONG ) 16000000 )
+
+	#define configTICK_RATE_HZ			( ( portTickType ) 1000 )
+	//##Same as the big AVR parts:
+	#define configMAX_PRIORITIES		( 16 )
+	#define configUSE_PRIORITY_BITMAP	1
+	#define configMINIMAL_STACK_SIZE	( ( unsigned portSHORT ) 85 )
+	#define configTOTAL_HEAP_SIZE		( (size_t ) ( 32768 ) )
+	#define configMAX_TASK_NAME_LEN		( 16 )
+	#define configUSE_PEND_CALL_TASK	1
+	#define configUSE_ACTIVE_OBJECTS	1
+	#define configUSE_TRACE_FACILITY	0
+	#define configUSE_16_BIT_TICKS		1
+	#define configIDLE_SHOULD_YIELD		0
+	#define configUSE_MUTEXES			1
+	#define configUSE_MUTEX_PRIORITY_CEILING	1
+	#define configUSE_CPU_LOAD			1
+	#define configQUEUE_REGISTRY_SIZE	0
+	#define configUSE_STATIC_ALLOCATION	1
+
+	/* Co-routine definitions. */
+	#define configUSE_CO_ROUTINES 		0
+	#define configMAX_CO_ROUTINE_PRIORITIES ( 2 )
+
+	/* Set the following definitions to 1 to include the API function, or zero
+	to exclude the API function. */
+	#define INCLUDE_vTaskPrioritySet		1
+	#define INCLUDE_uxTaskPriorityGet		1
+	#define INCLUDE_vTaskDelete				1
+	#define INCLUDE_vTaskCleanUpResources	0
+	#define INCLUDE_vTaskSuspend			1
+	#define INCLUDE_vTaskDelayUntil			1
+	#define INCLUDE_vTaskDelay				1
+
 #else
 	#error "Device is not supported by DuinOS"
 
@@ -33,6 +33,9 @@
 
 #include "wiring.h"
 #include "wiring_private.h"
+#include "DuinOS/FreeRTOS.h"
+#include "DuinOS/task.h"
+#include "DuinOS/pendcall.h"
 
 #if defined(__AVR_ATmega32U4__)
 #define NUM_INTERRUPT 4
@@ -42,6 +45,11 @@
 
 volatile static voidFuncPtr intFunc[NUM_INTERRUPT];
 
+#if configUSE_PEND_CALL_TASK
+// interrupts whose function runs in the DuinOS pend-call task
+volatile static uint8_t intDeferred;
+#endif
+
 static const uint8_t PROGMEM interrupt_mode_mask[] = {0xFC, 0xF3, 0xCF, 0x3F};
 
 #if defined(__AVR_ATmega32U4__)
@@ -51,6 +59,9 @@ void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), uint8_t mode)
 
 	if (interruptNum >= NUM_INTERRUPT) return;
 	intFunc[interruptNum] = userFunc;
+#if configUSE_PEND_CALL_TASK
+	intDeferred &= ~(1 << interruptNum);
+#endif
 	mask = pgm_read_byte(interrupt_mode_mask + interruptNum);
 	mode &= 0x03;
 	EICRA = (EICRA & mask) | (mode << (interruptNum * 2));
@@ -63,6 +74,9 @@ void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), uint8_t mode)
 
 	if (interruptNum >= NUM_INTERRUPT) return;
 	intFunc[interruptNum] = userFunc;
+#if configUSE_PEND_CALL_TASK
+	intDeferred &= ~(1 << interruptNum);
+#endif
 	index = interruptNum & 3;
 	mask = pgm_read_byte(interrupt_mode_mask + index);
 	mode &= 0x03;
@@ -75,6 +89,59 @@ void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), uint8_t mode)
 }
 #endif
 
+#if configUSE_PEND_CALL_TASK
+// Like attachInterrupt(), but userFunc runs in the pend-call task instead of
+// the interrupt, where it can take its time and use the DuinOS API.  The pin
+// is masked until userFunc has run, so a burst of edges is reported once.
+void attachDeferredInterrupt(uint8_t interruptNum, void (*userFunc)(void), uint8_t mode)
+{
+	uint8_t status;
+
+	if (interruptNum >= NUM_INTERRUPT) return;
+	if (xPendCallInitialise() != pdPASS) {
+		// no room for the pend-call task: run it in the interrupt
+		attachInterrupt(interruptNum, userFunc, mode);
+		return;
+	}
+	// marked deferred before the first interrupt can happen
+	portINTERRUPTS_OFF(status);
+	attachInterrupt(interruptNum, userFunc, mode);
+	intDeferred |= (1 << interruptNum);
+	portINTERRUPTS_RESTORE(status);
+}
+
+static void deferredInterrupt(void *param)
+{
+	uint8_t num = (uint8_t)(unsigned int)param;
+	voidFuncPtr func = intFunc[num];
+
+	if (func) func();
+	// unmask the pin again, unless it was detached meanwhile (this runs
+	// in the pend-call task, always with interrupts enabled)
+	portINTERRUPTS_OFF_FROM_TASK();
+	if (intFunc[num] && (intDeferred & (1 << num))) EIMSK |= (1 << num);
+	portINTERRUPTS_ON_FROM_TASK();
+}
+
+static inline void callInterrupt(uint8_t num)
+{
+	signed portBASE_TYPE woken = pdFALSE;
+	voidFuncPtr func = intFunc[num];
+
+	if (!func) return;
+	if ((intDeferred & (1 << num)) &&
+	  xPendFunctionCallFromISR(deferredInterrupt, (void *)(unsigned int)num, &woken) == pdPASS) {
+		EIMSK &= ~(1 << num);
+		if (woken) taskYIELD();
+		return;
+	}
+	func();
+}
+#define CALL_INTERRUPT(num) callInterrupt(num)
+#else
+#define CALL_INTERRUPT(num) if (intFunc[num]) intFunc[num]()
+#endif
+
 void detachInterrupt(uint8_t interruptNum)
 {
 	if (interruptNum >= NUM_INTERRUPT) return;
@@ -84,29 +151,29 @@ void detachInterrupt(uint8_t interruptNum)
 }
 
 SIGNAL(INT0_vect) {
-	if (intFunc[0]) intFunc[0]();	// INT0 is pin 0 (PD0)
+	CALL_INTERRUPT(0);	// INT0 is pin 0 (PD0)
 }
 SIGNAL(INT1_vect) {
-	if (intFunc[1]) intFunc[1]();	// INT1 is pin 1 (PD1)
+	CALL_INTERRUPT(1);	// INT1 is pin 1 (PD1)
 }
 SIGNAL(INT2_vect) {
-	if (intFunc[2]) intFunc[2]();	// INT2 is pin 2 (PD2) (also Serial RX)
+	CALL_INTERRUPT(2);	// INT2 is pin 2 (PD2) (also Serial RX)
 }
 SIGNAL(INT3_vect) {
-	if (intFunc[3]) intFunc[3]();	// INT3 is pin 3 (PD3) (also Serial TX)
+	CALL_INTERRUPT(3);	// INT3 is pin 3 (PD3) (also Serial TX)
 }
 #if !defined(__AVR_ATmega32U4__)
 SIGNAL(INT4_vect) {
-	if (intFunc[4]) intFunc[4]();	// INT4 is pin 20 (PC7)
+	CALL_INTERRUPT(4);	// INT4 is pin 20 (PC7)
 }
 SIGNAL(INT5_vect) {
-	if (intFunc[5]) intFunc[5]();	// INT5 is pin 4 (PD4)
+	CALL_INTERRUPT(5);	// INT5 is pin 4 (PD4)
 }
 SIGNAL(INT6_vect) {
-	if (intFunc[6]) intFunc[6]();	// INT6 is pin 6 (PD6)
+	CALL_INTERRUPT(6);	// INT6 is pin 6 (PD6)
 }
 SIGNAL(INT7_vect) {
-	if (intFunc[7]) intFunc[7]();	// INT7 is pin 7 (PD7)
+	CALL_INTERRUPT(7);	// INT7 is pin 7 (PD7)
 }
 #endif
 
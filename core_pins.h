@@ -1785,9 +1785,9 @@ extern uint32_t _micros(void) __attribute__((noinline));
 static inline uint32_t micros(void) __attribute__((always_inline, unused));
 static inline uint32_t micros(void)
 {
-	register uint32_t out asm("r22");
-	asm volatile("call _micros" : "=d" (out) : : "r0");
-	return out;
+	// a plain call, _micros() is written in C when the DuinOS tick is not
+	// the Timer 0 overflow
+	return _micros();
 }
 
 
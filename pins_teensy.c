@@ -29,6 +29,7 @@
 #include "pins_arduino.h"
 #include "usb_private.h"
 #include "core_pins.h"
+#include "DuinOS/FreeRTOS.h"
 
 #define FREE_RTOS 1
 #define DuinOS 1
@@ -250,10 +251,9 @@ void _pinMode_output(uint8_t pin)
 
 	if (pin >= CORE_NUM_TOTAL_PINS) return;
 	PIN_REG_AND_MASK_LOOKUP(pin, reg, mask);
-	status = SREG;
-	cli();
+	portINTERRUPTS_OFF(status);
 	*(reg + 1) |= mask;
-	SREG = status;
+	portINTERRUPTS_RESTORE(status);
 }
 
 void _pinMode_input(uint8_t pin)
@@ -263,11 +263,10 @@ void _pinMode_input(uint8_t pin)
 
 	if (pin >= CORE_NUM_TOTAL_PINS) return;
 	PIN_REG_AND_MASK_LOOKUP(pin, reg, mask);
-	status = SREG;
-	cli();
+	portINTERRUPTS_OFF(status);
 	*(reg + 1) &= ~mask;
 	*(reg + 2) &= ~mask;
-	SREG = status;
+	portINTERRUPTS_RESTORE(status);
 }
 
 
@@ -278,11 +277,10 @@ void _pinMode_input_pullup(uint8_t pin)
 
 	if (pin >= CORE_NUM_TOTAL_PINS) return;
 	PIN_REG_AND_MASK_LOOKUP(pin, reg, mask);
-	status = SREG;
-	cli();
+	portINTERRUPTS_OFF(status);
 	*(reg + 1) &= ~mask;
 	*(reg + 2) |= mask;
-	SREG = status;
+	portINTERRUPTS_RESTORE(status);
 }
 
 
@@ -1608,8 +1606,26 @@ void TIMER0_OVF_vect()
 }
 #else
 
+// kernel ticks, the time base of ulPortGetTimestamp()
 volatile unsigned long timer0_overflow_count = 0;
 
+#if configUSB_SOF_TIMEBASE
+// rate correction of millis() and micros() against the USB host clock,
+// in 1/65536 us per tick, the part of it not applied yet, and the
+// microseconds applied to micros() but not yet to millis()
+static volatile long timebase_correction = 0;
+static long timebase_fract = 0;
+static int timebase_millis_fract = 0;
+
+static void timebase_slew(unsigned long start, unsigned long *m, unsigned long *u);
+#endif
+
+#if configTICK_SOURCE == portTICK_SOURCE_TIMER0
+
+// called from the Timer 0 overflow, 1024 cycles of clk/64 = 1.024 ms at
+// 16 MHz: the fraction counts the 24 us in 1/125 ms steps, as the ISR above
+#define FRACT_MAX 125
+
 void arduino_increment_millis()
 {
 	// copy these to local variables so they can be stored in registers
@@ -1617,9 +1633,6 @@ void arduino_increment_millis()
 	unsigned long m = timer0_millis_count;
 	unsigned char f = timer0_fract_count;
 
-// no idea what this should be - rsanders
-#define FRACT_MAX 256
-
 	m += TIMER0_MILLIS_INC;
 	f += TIMER0_FRACT_INC;
 	if (f >= FRACT_MAX) {
@@ -1627,10 +1640,97 @@ void arduino_increment_millis()
 		m += 1;
 	}
 
+#if configUSB_SOF_TIMEBASE
+	// timer0_micros_count is in 256 us steps here, too coarse to
+	// correct, so only millis() follows the host
+	timebase_slew(timer0_millis_count, &m, NULL);
+#endif
 	timer0_fract_count = f;
 	timer0_millis_count = m;
+	timer0_micros_count += TIMER0_MICROS_INC;
+	timer0_overflow_count++;
+}
+
+// 1/65536 us per tick for each ppm of drift, times 256: 2^38 / F_CPU
+// for the 16384 cycles of a tick
+#define TIMEBASE_CORRECTION_PER_PPM	((long)(274877906944ULL / F_CPU))
+
+#else
+
+// called from the compare match of the tick timer, exactly 1/configTICK_RATE_HZ
+// seconds: the fractions count the remainder in 1/configTICK_RATE_HZ steps, and
+// timer0_micros_count holds whole microseconds
+#define TICK_MILLIS_INC		(1000UL / configTICK_RATE_HZ)
+#define TICK_MILLIS_FRACT	(1000UL % configTICK_RATE_HZ)
+#define TICK_MICROS_INC		(1000000UL / configTICK_RATE_HZ)
+#define TICK_MICROS_FRACT	(1000000UL % configTICK_RATE_HZ)
+
+static unsigned int tick_millis_fract = 0;
+static unsigned int tick_micros_fract = 0;
+
+void arduino_increment_millis()
+{
+	unsigned long m = timer0_millis_count + TICK_MILLIS_INC;
+	unsigned long u = timer0_micros_count + TICK_MICROS_INC;
+
+	tick_millis_fract += TICK_MILLIS_FRACT;
+	if (tick_millis_fract >= configTICK_RATE_HZ) {
+		tick_millis_fract -= configTICK_RATE_HZ;
+		m += 1;
+	}
+	tick_micros_fract += TICK_MICROS_FRACT;
+	if (tick_micros_fract >= configTICK_RATE_HZ) {
+		tick_micros_fract -= configTICK_RATE_HZ;
+		u += 1;
+	}
+#if configUSB_SOF_TIMEBASE
+	timebase_slew(timer0_millis_count, &m, &u);
+#endif
+
+	timer0_millis_count = m;
+	timer0_micros_count = u;
 	timer0_overflow_count++;
 }
+
+// 1/65536 us per tick for each ppm of drift, times 256: 2^24 divided
+// by the tick rate
+#define TIMEBASE_CORRECTION_PER_PPM	(16777216L / configTICK_RATE_HZ)
+
+#endif
+
+#if configUSB_SOF_TIMEBASE
+// add the whole microseconds of correction due this tick to micros(),
+// if u is given, and carry them to millis().  millis() only goes back
+// on a tick that moved it on, so it never runs backwards.
+static void timebase_slew(unsigned long start, unsigned long *m, unsigned long *u)
+{
+	long f = timebase_fract + timebase_correction;
+	int us = (int)(f >> 16);
+
+	timebase_fract = f - ((long)us << 16);
+	if (u) *u += us;
+	timebase_millis_fract += us;
+	if (timebase_millis_fract >= 1000) {
+		timebase_millis_fract -= 1000;
+		*m += 1;
+	} else if (timebase_millis_fract <= -1000 && *m != start) {
+		timebase_millis_fract += 1000;
+		*m -= 1;
+	}
+}
+
+// called by the USB start of frame interrupt with the drift of the
+// CPU clock against the host, in ppm (positive if it runs fast)
+void timebase_adjust(int ppm)
+{
+	uint8_t sreg;
+	long c = -(((long)ppm * TIMEBASE_CORRECTION_PER_PPM) >> 8);
+
+	portINTERRUPTS_OFF(sreg);
+	timebase_correction = c;
+	portINTERRUPTS_RESTORE(sreg);
+}
+#endif
 #endif
 
 #if !defined(DuinOS) && !defined(FREE_RTOS)
@@ -1644,21 +1744,37 @@ void delay(uint32_t ms)
 		while (ms--) delayMicroseconds(1000);
 		return;
 	}
-	// if interrupt are enabled, use low power idle mode
-	cli();
+	// if interrupt are enabled, use low power idle mode.  The sei just
+	// before sleep_cpu() takes effect after the sleep instruction, so an
+	// interrupt that ends the wait can not slip in before the CPU sleeps
+	portINTERRUPTS_OFF_FROM_TASK();
 	start = timer0_millis_count;
 	do {
 		_SLEEP_CONTROL_REG = SLEEP_MODE_IDLE | _SLEEP_ENABLE_MASK;
-		sei();
+		portINTERRUPTS_ON_FROM_TASK();
 		sleep_cpu();
 		_SLEEP_CONTROL_REG = SLEEP_MODE_IDLE;
-		cli();
+		portINTERRUPTS_OFF_FROM_TASK();
 	} while (timer0_millis_count - start <= ms);
-	sei();
+	portINTERRUPTS_ON_FROM_TASK();
 }
 #endif
 
 
+#if (defined(DuinOS) || defined(FREE_RTOS)) && configTICK_SOURCE != portTICK_SOURCE_TIMER0
+uint32_t _micros(void)
+{
+	uint8_t sreg;
+	uint32_t out;
+	uint16_t count;
+
+	portINTERRUPTS_OFF(sreg);
+	out = timer0_micros_count;
+	count = usPortTickFraction();
+	portINTERRUPTS_RESTORE(sreg);
+	return out + portTICK_FRACTION_TO_US(count);
+}
+#else
 uint32_t _micros(void)
 {
 	register uint32_t out asm("r22");
@@ -1717,6 +1833,7 @@ uint32_t _micros(void)
 	);
 	return out;
 }
+#endif
 
 
 
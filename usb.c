@@ -23,6 +23,12 @@
 
 
 #include "usb_private.h"
+#include "DuinOS/FreeRTOS.h"
+#include "DuinOS/task.h"
+#include "DuinOS/pendcall.h"
+#if configUSB_SUSPEND_POWER_DOWN
+#include <avr/sleep.h>
+#endif
 
 
 /**************************************************************************
@@ -37,6 +43,11 @@ static const uint8_t PROGMEM endpoint_config_table[] = {
 	1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(CDC_ACM_SIZE) | CDC_ACM_BUFFER,
 	1, EP_TYPE_BULK_OUT,      EP_SIZE(CDC_RX_SIZE) | CDC_RX_BUFFER,
 	1, EP_TYPE_BULK_IN,       EP_SIZE(CDC_TX_SIZE) | CDC_TX_BUFFER
+#if configUSB_VENDOR_BULK
+	,
+	1, EP_TYPE_BULK_OUT,      EP_SIZE(VENDOR_RX_SIZE) | VENDOR_RX_BUFFER,
+	1, EP_TYPE_BULK_IN,       EP_SIZE(VENDOR_TX_SIZE) | VENDOR_TX_BUFFER
+#endif
 };
 
 
@@ -56,9 +67,17 @@ static uint8_t PROGMEM device_descriptor[] = {
 	18,					// bLength
 	1,					// bDescriptorType
 	0x00, 0x02,				// bcdUSB
+#if configUSB_VENDOR_BULK
+	// composite, with an interface association descriptor
+	// grouping the two CDC interfaces
+	0xEF,					// bDeviceClass
+	0x02,					// bDeviceSubClass
+	0x01,					// bDeviceProtocol
+#else
 	2,					// bDeviceClass
 	0,					// bDeviceSubClass
 	0,					// bDeviceProtocol
+#endif
 	ENDPOINT0_SIZE,				// bMaxPacketSize0
 	LSB(VENDOR_ID), MSB(VENDOR_ID),		// idVendor
 	LSB(PRODUCT_ID), MSB(PRODUCT_ID),	// idProduct
@@ -69,18 +88,35 @@ static uint8_t PROGMEM device_descriptor[] = {
 	1					// bNumConfigurations
 };
 
+#if configUSB_VENDOR_BULK
+#define CONFIG1_DESC_SIZE (9+8+9+5+5+4+5+7+9+7+7+9+7+7)
+#define CONFIG1_INTERFACES 3
+#else
 #define CONFIG1_DESC_SIZE (9+9+5+5+4+5+7+9+7+7)
+#define CONFIG1_INTERFACES 2
+#endif
 static uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
 	// configuration descriptor, USB spec 9.6.3, page 264-266, Table 9-10
 	9, 					// bLength;
 	2,					// bDescriptorType;
 	LSB(CONFIG1_DESC_SIZE),			// wTotalLength
 	MSB(CONFIG1_DESC_SIZE),
-	2,					// bNumInterfaces
+	CONFIG1_INTERFACES,			// bNumInterfaces
 	1,					// bConfigurationValue
 	0,					// iConfiguration
 	0xC0,					// bmAttributes
 	50,					// bMaxPower
+#if configUSB_VENDOR_BULK
+	// interface association descriptor, USB ECN, Table 9-Z
+	8,					// bLength
+	11,					// bDescriptorType
+	0,					// bFirstInterface
+	2,					// bInterfaceCount
+	0x02,					// bFunctionClass
+	0x02,					// bFunctionSubClass
+	0x01,					// bFunctionProtocol
+	0,					// iFunction
+#endif
 	// interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
 	9,					// bLength
 	4,					// bDescriptorType
@@ -144,6 +180,33 @@ static uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
 	0x02,					// bmAttributes (0x02=bulk)
 	CDC_TX_SIZE, 0,				// wMaxPacketSize
 	0					// bInterval
+#if configUSB_VENDOR_BULK
+	,
+	// interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+	9,					// bLength
+	4,					// bDescriptorType
+	VENDOR_INTERFACE,			// bInterfaceNumber
+	0,					// bAlternateSetting
+	2,					// bNumEndpoints
+	0xFF,					// bInterfaceClass (vendor)
+	0x00,					// bInterfaceSubClass
+	0x00,					// bInterfaceProtocol
+	0,					// iInterface
+	// endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+	7,					// bLength
+	5,					// bDescriptorType
+	VENDOR_RX_ENDPOINT,			// bEndpointAddress
+	0x02,					// bmAttributes (0x02=bulk)
+	VENDOR_RX_SIZE, 0,			// wMaxPacketSize
+	0,					// bInterval
+	// endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+	7,					// bLength
+	5,					// bDescriptorType
+	VENDOR_TX_ENDPOINT | 0x80,		// bEndpointAddress
+	0x02,					// bmAttributes (0x02=bulk)
+	VENDOR_TX_SIZE, 0,			// wMaxPacketSize
+	0					// bInterval
+#endif
 };
 
 // If you're desperate for a little extra code memory, these strings
@@ -204,8 +267,10 @@ volatile uint8_t usb_configuration=0;
 volatile uint8_t usb_suspended=0;
 
 // the time remaining before we transmit any partially full
-// packet, or send a zero length packet.
+// packet, or send a zero length packet, and what it is set to
+// after each write.
 volatile uint8_t transmit_flush_timer=0;
+volatile uint8_t transmit_flush_timeout=TRANSMIT_FLUSH_TIMEOUT;
 uint8_t transmit_previous_timeout=0;
 
 
@@ -215,6 +280,95 @@ uint8_t transmit_previous_timeout=0;
 volatile uint8_t cdc_line_coding[7]={0x00, 0xE1, 0x00, 0x00, 0x00, 0x00, 0x08};
 volatile uint8_t cdc_line_rtsdtr=0;
 
+// the semaphores tasks sleep on, created empty by usb_init() so the
+// first wait sleeps
+#if configUSE_STATIC_ALLOCATION
+#define USB_SEMAPHORE(name) \
+	xSemaphoreHandle name=NULL; \
+	static xStaticQueue name##_queue; \
+	static uint8_t name##_storage[1]
+#define USB_SEMAPHORE_CREATE(name) \
+	if (!name) name = xQueueCreateStatic(1, semSEMAPHORE_QUEUE_ITEM_LENGTH, \
+		name##_storage, &name##_queue)
+#else
+#define USB_SEMAPHORE(name) \
+	xSemaphoreHandle name=NULL
+#define USB_SEMAPHORE_CREATE(name) \
+	if (!name) name = xQueueCreate(1, semSEMAPHORE_QUEUE_ITEM_LENGTH)
+#endif
+
+// given when a packet arrives on the CDC RX endpoint, or the device
+// is reset or suspended, to wake a task in Serial.readBlocking()
+USB_SEMAPHORE(usb_rx_semaphore);
+
+#if configUSB_SOF_TIMEBASE
+// the drift is measured over this many frames, and ignored if it is
+// beyond the crystal tolerance, after a glitch
+#define TIMEBASE_WINDOW		2048
+#define TIMEBASE_MAX_PPM	1000
+#define TIMEBASE_COUNTS_PER_MS	(configCPU_CLOCK_HZ / 1000UL / portTICK_PRESCALER)
+volatile uint32_t usb_sof_frame=0;
+volatile uint32_t usb_sof_timestamp=0;
+volatile int16_t usb_sof_ppm=0;
+static uint32_t timebase_start;
+static uint16_t timebase_frames=0;
+static uint8_t timebase_measured=0;
+#endif
+
+// what endpoint 0 waits for to carry on with a control transfer,
+// and the state of that transfer
+#define EP0_IDLE		0	// a setup packet
+#define EP0_DESCRIPTOR		1	// the host to take the next IN packet
+#define EP0_ADDRESS		2	// the status stage of SET_ADDRESS
+#define EP0_LINE_CODING		3	// the data stage of SET_LINE_CODING
+static uint8_t ep0_state=EP0_IDLE;
+static const uint8_t *ep0_data;
+static uint8_t ep0_length;
+
+#if configUSB_TX_RING_SIZE
+#if (configUSB_TX_RING_SIZE & (configUSB_TX_RING_SIZE - 1)) || configUSB_TX_RING_SIZE > 32768
+#error "configUSB_TX_RING_SIZE must be a power of two up to 32768"
+#endif
+// data written by Serial.write(), waiting for room in the endpoint
+uint8_t usb_tx_ring[configUSB_TX_RING_SIZE];
+volatile usb_tx_index_t usb_tx_head=0, usb_tx_tail=0;
+volatile uint8_t usb_tx_waiting=0;
+volatile uint8_t usb_tx_flush_pending=0;
+USB_SEMAPHORE(usb_tx_semaphore);
+#endif
+
+#if configUSB_EVENT_QUEUE_LENGTH
+// the connection changes not read by Serial.waitEvent() yet
+xQueueHandle usb_event_queue=NULL;
+#if configUSE_STATIC_ALLOCATION
+static xStaticQueue usb_event_queue_queue;
+static uint8_t usb_event_queue_storage[configUSB_EVENT_QUEUE_LENGTH + 1];
+#endif
+#endif
+
+// set when a control request woke a waiting task
+static signed portBASE_TYPE usb_control_woken=pdFALSE;
+
+// given when the host sets a configuration, for
+// Serial.waitConfigured(), and the callback of Serial.beginAsync()
+USB_SEMAPHORE(usb_configured_semaphore);
+void (*volatile usb_configured_hook)(void)=NULL;
+
+#if configUSB_SUSPEND_POWER_DOWN
+// set by Serial.parkOnSuspend() and Serial.onSuspend()
+xTaskHandle usb_suspend_tasks[USB_SUSPEND_TASKS];
+uint8_t (*volatile usb_suspend_hook)(uint8_t suspend)=NULL;
+#endif
+
+#if configUSB_VENDOR_BULK
+// given by the vendor endpoints, and on reset or suspend, to wake a
+// task in Vendor.read() or Vendor.write()
+USB_SEMAPHORE(usb_vendor_rx_semaphore);
+USB_SEMAPHORE(usb_vendor_tx_semaphore);
+// bytes Vendor.read() took from the packet in the RX bank
+uint8_t usb_vendor_rx_offset=0;
+#endif
+
 
 /**************************************************************************
  *
@@ -228,6 +382,25 @@ void usb_init(void)
 {
 	uint8_t u;
 
+	USB_SEMAPHORE_CREATE(usb_rx_semaphore);
+	USB_SEMAPHORE_CREATE(usb_configured_semaphore);
+	#if configUSB_TX_RING_SIZE
+	USB_SEMAPHORE_CREATE(usb_tx_semaphore);
+	#endif
+	#if configUSB_VENDOR_BULK
+	USB_SEMAPHORE_CREATE(usb_vendor_rx_semaphore);
+	USB_SEMAPHORE_CREATE(usb_vendor_tx_semaphore);
+	#endif
+	#if configUSB_EVENT_QUEUE_LENGTH
+	if (!usb_event_queue) {
+		#if configUSE_STATIC_ALLOCATION
+		usb_event_queue = xQueueCreateStatic(configUSB_EVENT_QUEUE_LENGTH, 1,
+			usb_event_queue_storage, &usb_event_queue_queue);
+		#else
+		usb_event_queue = xQueueCreate(configUSB_EVENT_QUEUE_LENGTH, 1);
+		#endif
+	}
+	#endif
 	u = USBCON;
 	if ((u & (1<<USBE)) && !(u & (1<<FRZCLK))) return;
 	HW_CONFIG();
@@ -265,12 +438,188 @@ void usb_shutdown(void)
  **************************************************************************/
 
 
+#if configUSB_SOF_TIMEBASE
+// Timestamp the start of frame, and once a window of frames has gone
+// by without a gap, compare the tick timer with the host's 1 ms per
+// frame.  A frame missed in suspend, or a reset, starts over.
+static void usb_sof_timebase(void)
+{
+	uint32_t now = ulPortGetTimestamp();
+	uint16_t frame, delta;
+	int32_t error, ppm;
+
+	frame = UDFNUML;
+	frame |= (uint16_t)UDFNUMH << 8;
+	delta = (frame - (uint16_t)usb_sof_frame) & 0x7FF;
+	usb_sof_frame += delta;
+	usb_sof_timestamp = now;
+	if (delta != 1) {
+		timebase_frames = 0;
+		timebase_start = now;
+		return;
+	}
+	if (++timebase_frames < TIMEBASE_WINDOW) return;
+	error = (int32_t)(now - timebase_start - TIMEBASE_WINDOW * TIMEBASE_COUNTS_PER_MS);
+	ppm = error * 1000 / (int32_t)(TIMEBASE_WINDOW * TIMEBASE_COUNTS_PER_MS / 1000);
+	timebase_frames = 0;
+	timebase_start = now;
+	if (ppm > TIMEBASE_MAX_PPM || ppm < -TIMEBASE_MAX_PPM) return;
+	// average with the last windows, as the interrupt latency
+	// adds a few counts either way
+	if (timebase_measured) ppm = (3 * (int32_t)usb_sof_ppm + ppm) / 4;
+	timebase_measured = 1;
+	usb_sof_ppm = ppm;
+	timebase_adjust(ppm);
+}
+
+// the frame count and the microseconds since its start of frame, on
+// the host's clock.  Only the low 11 bits of the frame count are the
+// host's frame number, the same on every device of the bus; the upper
+// bits are counted here.  64 bits, since the count in microseconds
+// would wrap after 71 minutes in 32.
+uint32_t usbHostFrame(void)
+{
+	uint32_t frame;
+	uint8_t sreg;
+
+	portINTERRUPTS_OFF(sreg);
+	frame = usb_sof_frame;
+	portINTERRUPTS_RESTORE(sreg);
+	return frame;
+}
+
+uint64_t usbHostMicros(void)
+{
+	uint64_t frame;
+	uint32_t counts;
+	uint16_t us;
+	uint8_t sreg;
+
+	portINTERRUPTS_OFF(sreg);
+	frame = usb_sof_frame;
+	counts = ulPortGetTimestamp() - usb_sof_timestamp;
+	portINTERRUPTS_RESTORE(sreg);
+	// the frames stopped, in suspend
+	if (counts >= TIMEBASE_COUNTS_PER_MS) return frame * 1000 + 999;
+	us = portTICK_FRACTION_TO_US(counts);
+	return frame * 1000 + us;
+}
+
+int16_t usbClockPPM(void)
+{
+	return usb_sof_ppm;
+}
+#endif
+
+
+#if configUSB_EVENT_QUEUE_LENGTH
+// Queue a connection change for Serial.waitEvent().  Called with
+// interrupts disabled.  Once the queue is full, newer events are
+// dropped until the task catches up.
+void usb_event(uint8_t event, signed portBASE_TYPE *woken)
+{
+	if (usb_event_queue) xQueueSendFromISR(usb_event_queue, &event, woken);
+}
+
+// the same from a control request, which may run in the pend-call task
+static void usb_control_event(uint8_t event)
+{
+	uint8_t sreg;
+
+	portINTERRUPTS_OFF(sreg);
+	usb_event(event, &usb_control_woken);
+	portINTERRUPTS_RESTORE(sreg);
+}
+#endif
+
+// The host set a configuration: wake the task in
+// Serial.waitConfigured() and run the callback of Serial.beginAsync(),
+// in the pend-call task if there is one, else in this interrupt.
+#if configUSE_PEND_CALL_TASK
+static void usb_configured_call(void *unused)
+{
+	void (*hook)(void) = usb_configured_hook;
+
+	if (hook) hook();
+}
+#endif
+
+static void usb_configured(void)
+{
+	void (*hook)(void) = usb_configured_hook;
+	uint8_t sreg;
+
+	portINTERRUPTS_OFF(sreg);
+	if (usb_configured_semaphore) {
+		xSemaphoreGiveFromISR(usb_configured_semaphore, &usb_control_woken);
+	}
+	#if configUSE_PEND_CALL_TASK
+	if (hook && xPendFunctionCallFromISR(usb_configured_call, NULL,
+	  &usb_control_woken) == pdPASS) hook = NULL;
+	#endif
+	portINTERRUPTS_RESTORE(sreg);
+	// without the pend-call task, or before the scheduler starts
+	if (hook) hook();
+}
+
+
+#if configUSB_SUSPEND_POWER_DOWN
+// Queued by the suspend interrupt, runs in the pend-call task.  Unless
+// the hook vetoes it, eg. on a self powered board, the registered
+// tasks are suspended and the CPU sleeps in power down mode.  Only
+// WAKEUPI and the external interrupts wake it, the timers are stopped.
+// The USB interrupt restarts the PLL on resume and clears
+// usb_suspended, then the tasks parked here carry on where they were.
+// Tasks the sketch suspended itself are neither parked nor resumed.
+static void usb_suspend_deferred(void *unused)
+{
+	uint8_t (*hook)(uint8_t) = usb_suspend_hook;
+	xTaskHandle parked[USB_SUSPEND_TASKS];
+	xTaskHandle task;
+	uint8_t i, smcr;
+
+	// resumed before this got to run
+	if (!usb_suspended) return;
+	if (hook && !hook(1)) return;
+	for (i=0; i < USB_SUSPEND_TASKS; i++) {
+		parked[i] = NULL;
+		taskENTER_CRITICAL();
+		task = usb_suspend_tasks[i];
+		if (task && xTaskIsTaskSuspended(task) != pdTRUE) {
+			vTaskSuspend(task);
+			parked[i] = task;
+		}
+		taskEXIT_CRITICAL();
+	}
+	cli();
+	// the sketch or delay() may use another sleep mode
+	smcr = _SLEEP_CONTROL_REG;
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	while (usb_suspended) {
+		sleep_enable();
+		// the instruction after sei runs before any interrupt,
+		// so a resume between the test and the sleep wakes it
+		asm volatile("sei" "\n\t" "sleep" ::: "memory");
+		sleep_disable();
+		cli();
+	}
+	_SLEEP_CONTROL_REG = smcr;
+	sei();
+	if (hook) hook(0);
+	for (i=0; i < USB_SUSPEND_TASKS; i++) {
+		if (parked[i]) vTaskResume(parked[i]);
+	}
+}
+#endif
+
+
 // USB Device Interrupt - handle all device-level events
 // the transmit buffer flushing is triggered by the start of frame
 //
 ISR(USB_GEN_vect)
 {
 	uint8_t intbits, t;
+	signed portBASE_TYPE woken = pdFALSE;
 
         intbits = UDINT;
         UDINT = 0;
@@ -281,18 +630,43 @@ ISR(USB_GEN_vect)
 		UECFG0X = EP_TYPE_CONTROL;
 		UECFG1X = EP_SIZE(ENDPOINT0_SIZE) | EP_SINGLE_BUFFER;
 		UEIENX = (1<<RXSTPE);
+		ep0_state = EP0_IDLE;
 		usb_configuration = 0;
 		cdc_line_rtsdtr = 0;
+		// no packet is coming, let a reader see that
+		if (usb_rx_semaphore) xSemaphoreGiveFromISR(usb_rx_semaphore, &woken);
+		#if configUSB_TX_RING_SIZE
+		// nor is the host taking the data in the ring
+		usb_tx_tail = usb_tx_head;
+		if (usb_tx_semaphore) xSemaphoreGiveFromISR(usb_tx_semaphore, &woken);
+		#endif
+		#if configUSB_VENDOR_BULK
+		if (usb_vendor_rx_semaphore) xSemaphoreGiveFromISR(usb_vendor_rx_semaphore, &woken);
+		if (usb_vendor_tx_semaphore) xSemaphoreGiveFromISR(usb_vendor_tx_semaphore, &woken);
+		#endif
+		#if configUSB_EVENT_QUEUE_LENGTH
+		usb_event(USB_EVENT_RESET, &woken);
+		#endif
 	}
 	if (intbits & (1<<SOFI)) {
 		// Start Of Frame
+		#if configUSB_SOF_TIMEBASE
+		usb_sof_timebase();
+		#endif
 		if (usb_configuration) {
+			#if configUSB_TX_RING_SIZE
+			if (usb_tx_tail != usb_tx_head) usb_tx_drain(&woken);
+			#endif
 			t = transmit_flush_timer;
 			if (t) {
 				transmit_flush_timer = --t;
 				if (!t) {
+					// endpoint 0 may be in use by a
+					// deferred control request
+					uint8_t ep = UENUM;
 					UENUM = CDC_TX_ENDPOINT;
 					UEINTX = 0x3A;
+					UENUM = ep;
 				}
 			}
 		}
@@ -303,6 +677,17 @@ ISR(USB_GEN_vect)
 		UDIEN = (1<<WAKEUPE);
 		usb_configuration = 0;
 		usb_suspended = 1;
+		if (usb_rx_semaphore) xSemaphoreGiveFromISR(usb_rx_semaphore, &woken);
+		#if configUSB_TX_RING_SIZE
+		if (usb_tx_semaphore) xSemaphoreGiveFromISR(usb_tx_semaphore, &woken);
+		#endif
+		#if configUSB_VENDOR_BULK
+		if (usb_vendor_rx_semaphore) xSemaphoreGiveFromISR(usb_vendor_rx_semaphore, &woken);
+		if (usb_vendor_tx_semaphore) xSemaphoreGiveFromISR(usb_vendor_tx_semaphore, &woken);
+		#endif
+		#if configUSB_EVENT_QUEUE_LENGTH
+		usb_event(USB_EVENT_SUSPEND, &woken);
+		#endif
 		#if (F_CPU >= 8000000L)
 		// WAKEUPI does not work with USB clock freeze 
 		// when CPU is running less than 8 MHz.
@@ -314,6 +699,11 @@ ISR(USB_GEN_vect)
 		// reduce to less than 2.5 mA, which means using
 		// powerdown mode, but that breaks the Arduino
 		// user's paradigm....
+		#if configUSB_SUSPEND_POWER_DOWN
+		// ....unless the sketch asked for it, then the
+		// pend-call task parks the tasks and powers down
+		xPendFunctionCallFromISR(usb_suspend_deferred, NULL, &woken);
+		#endif
 	}
 	if (usb_suspended && (intbits & (1<<WAKEUPI))) {
 		// USB Resume (pretty much any activity)
@@ -324,11 +714,60 @@ ISR(USB_GEN_vect)
 		#endif
 		UDIEN = (1<<EORSTE)|(1<<SOFE)|(1<<SUSPE);
 		usb_suspended = 0;
-		return;
+		#if configUSB_EVENT_QUEUE_LENGTH
+		usb_event(USB_EVENT_RESUME, &woken);
+		#endif
 	}
+	if (woken) taskYIELD();
 }
 
 
+#if configUSB_TX_RING_SIZE
+// Move data from the transmit ring into the free banks of the CDC TX
+// endpoint, sending each packet it fills, and wake a writer waiting
+// for room.  With data left over, the endpoint interrupt is enabled
+// to carry on when the host takes a bank.  Once the ring is empty, a
+// partial packet is released if a flush is pending.  Called with
+// interrupts disabled, from the interrupts and Serial.write().
+void usb_tx_drain(signed portBASE_TYPE *woken)
+{
+	usb_tx_index_t tail = usb_tx_tail, head = usb_tx_head;
+	uint8_t ep, n, moved = 0;
+
+	// endpoint 0 may be in use by a deferred control request
+	ep = UENUM;
+	UENUM = CDC_TX_ENDPOINT;
+	while (tail != head && (UEINTX & (1<<RWAL))) {
+		n = CDC_TX_SIZE - UEBCLX;
+		do {
+			UEDATX = usb_tx_ring[tail];
+			tail = (tail + 1) & USB_TX_RING_MASK;
+		} while (--n && tail != head);
+		// if this completed a packet, transmit it now!
+		if (!(UEINTX & (1<<RWAL))) UEINTX = 0x3A;
+		transmit_flush_timer = transmit_flush_timeout;
+		moved = 1;
+	}
+	usb_tx_tail = tail;
+	// Serial.send_now() was called while the ring held data
+	if (tail == head && usb_tx_flush_pending) {
+		usb_tx_flush_pending = 0;
+		if ((UEINTX & (1<<RWAL)) && UEBCLX) {
+			UEINTX = 0x3A;
+			transmit_flush_timer = 0;
+		}
+	}
+	// both banks are busy if data is left, so TXINI is clear
+	// until the host takes one
+	UEIENX = (tail != head) ? (1<<TXINE) : 0;
+	UENUM = ep;
+	if (moved && usb_tx_waiting) {
+		usb_tx_waiting = 0;
+		xSemaphoreGiveFromISR(usb_tx_semaphore, woken);
+	}
+}
+#endif
+
 // Misc functions to wait for ready and send/receive packets
 static inline void usb_wait_in_ready(void)
 {
@@ -338,10 +777,6 @@ static inline void usb_send_in(void)
 {
 	UEINTX = ~(1<<TXINI);
 }
-static inline void usb_wait_receive_out(void)
-{
-	while (!(UEINTX & (1<<RXOUTI))) ;
-}
 static inline void usb_ack_out(void)
 {
 	UEINTX = ~(1<<RXOUTI);
@@ -349,16 +784,39 @@ static inline void usb_ack_out(void)
 
 
 
-// USB Endpoint Interrupt - endpoint 0 is handled here.  The
-// other endpoints are manipulated by the user-callable
-// functions, and the start-of-frame interrupt.
+static void jump_to_bootloader(void);
+
+// Endpoint 0 control requests.  They run in the USB_COM interrupt,
+// or in the DuinOS pend-call task when configUSE_PEND_CALL_TASK is
+// set.  Nothing waits on the host: a setup packet is answered at
+// once if the reply fits in one packet, otherwise ep0_state says
+// what to wait for and the TXINI or RXOUTI interrupt of endpoint 0
+// continues the transfer, one stage per call.
 //
-ISR(USB_COM_vect)
+// send the next IN packet of a descriptor, and go back to waiting
+// for a setup packet after the last one
+static void usb_send_descriptor(void)
+{
+	const uint8_t *list = ep0_data;
+	uint8_t i, n;
+
+	n = ep0_length < ENDPOINT0_SIZE ? ep0_length : ENDPOINT0_SIZE;
+	for (i = n; i; i--) {
+		pgm_read_byte_postinc(UEDATX, list);
+	}
+	ep0_data = list;
+	ep0_length -= n;
+	usb_send_in();
+	// a full packet at the end is followed by a zero length one
+	if (!ep0_length && n < ENDPOINT0_SIZE) ep0_state = EP0_IDLE;
+}
+
+static void usb_control_stage(void)
 {
         uint8_t intbits;
 	const uint8_t *list;
         const uint8_t *cfg;
-	uint8_t i, n, len, en;
+	uint8_t i, len, en;
 	uint8_t *p;
 	uint8_t bmRequestType;
 	uint8_t bRequest;
@@ -368,9 +826,46 @@ ISR(USB_COM_vect)
 	uint16_t desc_val;
 	const uint8_t *desc_addr;
 	uint8_t	desc_length;
+	#if configUSB_TX_RING_SIZE
+	uint8_t sreg;
+	#endif
 
 	UENUM = 0;
 	intbits = UEINTX;
+	if (!(intbits & (1<<RXSTPI))) {
+		// a later stage of the transfer in progress
+		switch (ep0_state) {
+		  case EP0_DESCRIPTOR:
+			// an OUT packet is the host ending it early
+			if (intbits & (1<<RXOUTI)) ep0_state = EP0_IDLE;
+			else if (intbits & (1<<TXINI)) usb_send_descriptor();
+			break;
+		  case EP0_ADDRESS:
+			if (intbits & (1<<TXINI)) {
+				UDADDR = ep0_length | (1<<ADDEN);
+				ep0_state = EP0_IDLE;
+			}
+			break;
+		  case EP0_LINE_CODING:
+			if (intbits & (1<<RXOUTI)) {
+				p = cdc_line_coding;
+				for (i=0; i<7; i++) {
+					*p++ = UEDATX;
+				}
+				usb_ack_out();
+				usb_send_in();
+				ep0_state = EP0_IDLE;
+				if (*(long *)cdc_line_coding == 134L) jump_to_bootloader();
+				#if configUSB_EVENT_QUEUE_LENGTH
+				usb_control_event(USB_EVENT_LINE_CODING);
+				#endif
+			}
+			break;
+		}
+		return;
+	}
+	// a setup packet ends whatever transfer was in progress
+	ep0_state = EP0_IDLE;
 	if (intbits & (1<<RXSTPI)) {
 		bmRequestType = UEDATX;
 		bRequest = UEDATX;
@@ -413,38 +908,36 @@ ISR(USB_COM_vect)
 			}
 			len = (wLength < 256) ? wLength : 255;
 			if (len > desc_length) len = desc_length;
-			list = desc_addr;
-			do {
-				// wait for host ready for IN packet
-				do {
-					i = UEINTX;
-				} while (!(i & ((1<<TXINI)|(1<<RXOUTI))));
-				if (i & (1<<RXOUTI)) return;	// abort
-				// send IN packet
-				n = len < ENDPOINT0_SIZE ? len : ENDPOINT0_SIZE;
-				for (i = n; i; i--) {
-					//UEDATX = pgm_read_byte(desc_addr++);
-					//pgm_read_byte_postinc(UEDATX, desc_addr);
-					pgm_read_byte_postinc(UEDATX, list);
-				}
-				len -= n;
-				usb_send_in();
-			} while (len || n == ENDPOINT0_SIZE);
+			ep0_data = desc_addr;
+			ep0_length = len;
+			ep0_state = EP0_DESCRIPTOR;
+			// the rest goes as the host takes each packet
+			if (UEINTX & (1<<TXINI)) usb_send_descriptor();
 			return;
                 }
 		if (bRequest == SET_ADDRESS) {
+			// the address is only taken after the status stage
+			ep0_length = wValue;
+			ep0_state = EP0_ADDRESS;
 			usb_send_in();
-			usb_wait_in_ready();
-			UDADDR = wValue | (1<<ADDEN);
 			return;
 		}
 		if (bRequest == SET_CONFIGURATION && bmRequestType == 0) {
 			usb_configuration = wValue;
 			cdc_line_rtsdtr = 0;
 			transmit_flush_timer = 0;
+			#if configUSB_TX_RING_SIZE
+			// the endpoints are reset, and what they held lost
+			portINTERRUPTS_OFF(sreg);
+			usb_tx_tail = usb_tx_head;
+			portINTERRUPTS_RESTORE(sreg);
+			#endif
+			#if configUSB_VENDOR_BULK
+			usb_vendor_rx_offset = 0;
+			#endif
 			usb_send_in();
 			cfg = endpoint_config_table;
-			for (i=1; i<5; i++) {
+			for (i=1; i<=MAX_ENDPOINT; i++) {
 				UENUM = i;
 				//en = pgm_read_byte(cfg++);
 				pgm_read_byte_postinc(en, cfg);
@@ -456,8 +949,14 @@ ISR(USB_COM_vect)
 					pgm_read_byte_postinc(UECFG1X, cfg);
 				}
 			}
-        		UERST = 0x1E;
+        		UERST = (2<<MAX_ENDPOINT) - 2;
         		UERST = 0;
+			if (usb_configuration) {
+				usb_configured();
+				#if configUSB_EVENT_QUEUE_LENGTH
+				usb_control_event(USB_EVENT_CONFIGURED);
+				#endif
+			}
 			return;
 		}
 		if (bRequest == GET_CONFIGURATION && bmRequestType == 0x80) {
@@ -476,50 +975,23 @@ ISR(USB_COM_vect)
 			return;
 		}
 		if (bRequest == CDC_SET_LINE_CODING && bmRequestType == 0x21) {
-			usb_wait_receive_out();
-			p = cdc_line_coding;
-			for (i=0; i<7; i++) {
-				*p++ = UEDATX;
-			}
-			usb_ack_out();
-			usb_send_in();
-			if (*(long *)cdc_line_coding == 134L) goto jump_to_bootloader;
+			// the line coding comes in the data stage
+			ep0_state = EP0_LINE_CODING;
 			return;
 		}
 		if (bRequest == CDC_SET_CONTROL_LINE_STATE && bmRequestType == 0x21) {
 			cdc_line_rtsdtr = wValue;
 			usb_wait_in_ready();
 			usb_send_in();
+			#if configUSB_EVENT_QUEUE_LENGTH
+			usb_control_event(USB_EVENT_LINE_STATE);
+			#endif
 			return;
 		}
 		if (bRequest == CDC_SEND_BREAK && bmRequestType == 0x21) {
 			usb_wait_in_ready();
 			usb_send_in();
-			jump_to_bootloader:
-			// TODO: 5 ms delay?
-			UDCON = 1;
-			USBCON = (1<<FRZCLK);
-			UCSR1B = 0;
-			#if defined(__AVR_AT90USB162__)
-			DDRB = 0; DDRC = 0; DDRD = 0;
-			TIMSK0 = 0; TIMSK1 = 0;
-			asm volatile("jmp 0x1F00");
-			#elif defined(__AVR_ATmega32U4__)
-			DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
-			TIMSK0 = 0; TIMSK1 = 0; TIMSK3 = 0; TIMSK4 = 0;
-			ADCSRA = 0;
-			asm volatile("jmp 0x3F00");
-			#elif defined(__AVR_AT90USB646__)
-			DDRA = 0; DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
-			TIMSK0 = 0; TIMSK1 = 0; TIMSK2 = 0; TIMSK3 = 0;
-			ADCSRA = 0;
-			asm volatile("jmp 0x7E00");
-			#elif defined(__AVR_AT90USB1286__)
-			DDRA = 0; DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
-			TIMSK0 = 0; TIMSK1 = 0; TIMSK2 = 0; TIMSK3 = 0;
-			ADCSRA = 0;
-			asm volatile("jmp 0xFE00");
-			#endif
+			jump_to_bootloader();
 			return;
 		}
 		if (bRequest == GET_STATUS) {
@@ -555,4 +1027,123 @@ ISR(USB_COM_vect)
 	UECONX = (1<<STALLRQ) | (1<<EPEN);	// stall
 }
 
+// leave the sketch for the HalfKay bootloader, as the Teensy loader
+// asks with a break or a 134 baud line coding
+static void jump_to_bootloader(void)
+{
+	cli();
+	// TODO: 5 ms delay?
+	UDCON = 1;
+	USBCON = (1<<FRZCLK);
+	UCSR1B = 0;
+	#if defined(__AVR_AT90USB162__)
+	DDRB = 0; DDRC = 0; DDRD = 0;
+	TIMSK0 = 0; TIMSK1 = 0;
+	asm volatile("jmp 0x1F00");
+	#elif defined(__AVR_ATmega32U4__)
+	DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
+	TIMSK0 = 0; TIMSK1 = 0; TIMSK3 = 0; TIMSK4 = 0;
+	ADCSRA = 0;
+	asm volatile("jmp 0x3F00");
+	#elif defined(__AVR_AT90USB646__)
+	DDRA = 0; DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
+	TIMSK0 = 0; TIMSK1 = 0; TIMSK2 = 0; TIMSK3 = 0;
+	ADCSRA = 0;
+	asm volatile("jmp 0x7E00");
+	#elif defined(__AVR_AT90USB1286__)
+	DDRA = 0; DDRB = 0; DDRC = 0; DDRD = 0; DDRE = 0; DDRF = 0;
+	TIMSK0 = 0; TIMSK1 = 0; TIMSK2 = 0; TIMSK3 = 0;
+	ADCSRA = 0;
+	asm volatile("jmp 0xFE00");
+	#endif
+}
+
+// handle one event on endpoint 0, then enable the interrupts that
+// carry on with the transfer
+static void usb_control(void)
+{
+	uint8_t en = (1<<RXSTPE);
+
+	usb_control_stage();
+	UENUM = 0;
+	if (ep0_state == EP0_DESCRIPTOR) en |= (1<<TXINE)|(1<<RXOUTE);
+	else if (ep0_state == EP0_ADDRESS) en |= (1<<TXINE);
+	else if (ep0_state == EP0_LINE_CODING) en |= (1<<RXOUTE);
+	UEIENX = en;
+}
+
+#if configUSE_PEND_CALL_TASK
+static void usb_control_deferred(void *unused)
+{
+	// no other task may select an endpoint meanwhile, but
+	// interrupts stay enabled
+	vTaskSuspendAll();
+	usb_control();
+	// resuming the scheduler switches to a task it woke
+	usb_control_woken = pdFALSE;
+	xTaskResumeAll();
+}
+#endif
+
+// Wake the task a data endpoint interrupt was enabled for.  The
+// interrupt is masked until the task sleeps again.  Endpoint 0 may
+// be in use by a deferred control request.
+static inline void usb_endpoint_wake(uint8_t endpoint, xSemaphoreHandle semaphore, signed portBASE_TYPE *woken)
+{
+	uint8_t ep = UENUM;
+	UENUM = endpoint;
+	UEIENX = 0;
+	UENUM = ep;
+	xSemaphoreGiveFromISR(semaphore, woken);
+}
+
+// USB Endpoint Interrupt - endpoint 0 is handled here.  The
+// other endpoints are manipulated by the user-callable
+// functions, and the start-of-frame interrupt, except for
+// the CDC RX and vendor endpoint interrupts which wake a
+// task sleeping in Serial.readBlocking() or the Vendor
+// object.
+//
+ISR(USB_COM_vect)
+{
+	signed portBASE_TYPE woken = pdFALSE;
 
+	if (UEINT & (1<<CDC_RX_ENDPOINT)) {
+		usb_endpoint_wake(CDC_RX_ENDPOINT, usb_rx_semaphore, &woken);
+	}
+#if configUSB_VENDOR_BULK
+	if (UEINT & (1<<VENDOR_RX_ENDPOINT)) {
+		usb_endpoint_wake(VENDOR_RX_ENDPOINT, usb_vendor_rx_semaphore, &woken);
+	}
+	if (UEINT & (1<<VENDOR_TX_ENDPOINT)) {
+		usb_endpoint_wake(VENDOR_TX_ENDPOINT, usb_vendor_tx_semaphore, &woken);
+	}
+#endif
+#if configUSB_TX_RING_SIZE
+	if (UEINT & (1<<CDC_TX_ENDPOINT)) {
+		// the host took a bank, refill it from the ring
+		usb_tx_drain(&woken);
+	}
+#endif
+	if (!(UEINT & (1<<0))) {
+		if (woken) taskYIELD();
+		return;
+	}
+#if configUSE_PEND_CALL_TASK
+	// masked until the deferred request has been handled
+	UENUM = 0;
+	UEIENX = 0;
+	if (xPendFunctionCallFromISR(usb_control_deferred, NULL, &woken) == pdPASS) {
+		if (woken) taskYIELD();
+		return;
+	}
+	// the scheduler is not running yet, or the queue is full
+	UEIENX = (1<<RXSTPE);
+#endif
+	usb_control();
+	if (usb_control_woken) {
+		usb_control_woken = pdFALSE;
+		woken = pdTRUE;
+	}
+	if (woken) taskYIELD();
+}
@@ -26,6 +26,14 @@
 #include "usb_private.h"
 #include "usb_api.h"
 #include "wiring.h"
+#include "DuinOS/FreeRTOS.h"
+#include "DuinOS/guard.h"
+
+// Unrolled copies between a buffer and an endpoint FIFO
+#define ASM_COPY1(src, dest, tmp) "ld " tmp ", " src "\n\t" "st " dest ", " tmp "\n\t"
+#define ASM_COPY2(src, dest, tmp) ASM_COPY1(src, dest, tmp) ASM_COPY1(src, dest, tmp)
+#define ASM_COPY4(src, dest, tmp) ASM_COPY2(src, dest, tmp) ASM_COPY2(src, dest, tmp)
+#define ASM_COPY8(src, dest, tmp) ASM_COPY4(src, dest, tmp) ASM_COPY4(src, dest, tmp)
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -55,6 +63,39 @@ void usb_serial_class::begin(long speed)
 	}
 }
 
+// start USB and return at once, instead of waiting for the host like
+// begin().  configured, if given, is called each time the host sets a
+// configuration: from the pend-call task when there is one, else from
+// the USB interrupt, so it must be short and must not block.  If the
+// host has configured the device already, as it may have since init()
+// starts USB before setup(), it is called from here.
+void usb_serial_class::beginAsync(void (*configured)(void))
+{
+	uint8_t now;
+
+	usb_init();
+	{
+		// so the interrupt and this do not both call it
+		InterruptLock lock;
+		usb_configured_hook = configured;
+		now = usb_configuration;
+	}
+	if (configured && now) configured();
+}
+
+// wait up to timeout ticks for the host to configure the device, from
+// a task.  Returns 1 once it is configured, or 0.  The host may still
+// need a moment to load its driver before it opens the port, which
+// begin() waits 200 ms for.
+uint8_t usb_serial_class::waitConfigured(portTickType timeout)
+{
+	if (!usb_configured_semaphore) return 0;
+	// a give left over from an earlier configuration
+	xSemaphoreTake(usb_configured_semaphore, 0);
+	if (!usb_configuration) xSemaphoreTake(usb_configured_semaphore, timeout);
+	return usb_configuration ? 1 : 0;
+}
+
 void usb_serial_class::end(void)
 {
 	usb_shutdown();
@@ -64,10 +105,9 @@ void usb_serial_class::end(void)
 // number of bytes available in the receive buffer
 uint8_t usb_serial_class::available(void)
 {
-        uint8_t n=0, i, intr_state;
+        uint8_t n=0, i;
+        InterruptLock lock;
 
-        intr_state = SREG;
-        cli();
         if (usb_configuration) {
                 UENUM = CDC_RX_ENDPOINT;
                 n = UEBCLX;
@@ -76,24 +116,19 @@ uint8_t usb_serial_class::available(void)
 			if (i & (1<<RXOUTI) && !(i & (1<<RWAL))) UEINTX = 0x6B;
 		}
         }
-        SREG = intr_state;
         return n;
 }
 
 // get the next character, or -1 if nothing received
 int usb_serial_class::read(void)
 {
-        uint8_t c, intr_state;
+        uint8_t c;
 
         // interrupts are disabled so these functions can be
         // used from the main program or interrupt context,
         // even both in the same program!
-        intr_state = SREG;
-        cli();
-        if (!usb_configuration) {
-                SREG = intr_state;
-                return -1;
-        }
+        InterruptLock lock;
+        if (!usb_configuration) return -1;
         UENUM = CDC_RX_ENDPOINT;
 	retry:
 	c = UEINTX;
@@ -103,30 +138,138 @@ int usb_serial_class::read(void)
 			UEINTX = 0x6B;
 			goto retry;
 		}
-                SREG = intr_state;
                 return -1;
         }
         // take one byte out of the buffer
         c = UEDATX;
         // if this drained the buffer, release it
         if (!(UEINTX & (1<<RWAL))) UEINTX = 0x6B;
-        SREG = intr_state;
         return c;
 }
 
+// read up to size bytes of the data already received, a whole
+// packet at a time, and return how many were read
+uint16_t usb_serial_class::read(uint8_t *buffer, uint16_t size)
+{
+	uint8_t i, read_size;
+	uint16_t count = 0;
+
+	while (size) {
+		// interrupts are disabled for one packet at a time
+		InterruptLock lock;
+		if (!usb_configuration) break;
+		UENUM = CDC_RX_ENDPOINT;
+		i = UEINTX;
+		if (!(i & (1<<RWAL))) {
+			// no data in buffer, release an empty packet
+			if (i & (1<<RXOUTI)) {
+				UEINTX = 0x6B;
+				continue;
+			}
+			break;
+		}
+		read_size = UEBCLX;
+		if (read_size > size) read_size = size;
+		size -= read_size;
+		count += read_size;
+
+		// copy the packet, or the part of it asked for
+		do {
+			uint8_t tmp;
+			asm volatile(
+			"L%=begin:"					"\n\t"
+				"ldi	r30, %4"			"\n\t"
+				"sub	r30, %3"			"\n\t"
+				"cpi	r30, %4"			"\n\t"
+				"brsh	L%=err"				"\n\t"
+				"lsl	r30"				"\n\t"
+				"clr	r31"				"\n\t"
+				"subi	r30, lo8(-(pm(L%=table)))"	"\n\t"
+				"sbci	r31, hi8(-(pm(L%=table)))"	"\n\t"
+				"ijmp"					"\n\t"
+			"L%=err:"					"\n\t"
+				"rjmp	L%=end"				"\n\t"
+			"L%=table:"					"\n\t"
+				#if (CDC_RX_SIZE == 64)
+				ASM_COPY8("X", "Y+", "%1")
+				ASM_COPY8("X", "Y+", "%1")
+				ASM_COPY8("X", "Y+", "%1")
+				ASM_COPY8("X", "Y+", "%1")
+				#endif
+				#if (CDC_RX_SIZE >= 32)
+				ASM_COPY8("X", "Y+", "%1")
+				ASM_COPY8("X", "Y+", "%1")
+				#endif
+				#if (CDC_RX_SIZE >= 16)
+				ASM_COPY8("X", "Y+", "%1")
+				#endif
+				ASM_COPY8("X", "Y+", "%1")
+			"L%=end:"					"\n\t"
+				: "+y" (buffer), "=r" (tmp)
+				: "0" (buffer), "r" (read_size), "M" (CDC_RX_SIZE), "x" (&UEDATX)
+				: "r30", "r31", "memory"
+			);
+		} while (0);
+
+		// if this drained the packet, release it
+		if (!(UEINTX & (1<<RWAL))) UEINTX = 0x6B;
+	}
+	return count;
+}
+
+// sleep until the host sends a packet, for at most the given
+// number of ticks.  Returns zero if it did not come or USB is
+// offline.  The RX endpoint interrupt wakes us up.
+static uint8_t receive_wait(portTickType ticks)
+{
+	{
+		InterruptLock lock;
+		if (!usb_configuration) return 0;
+		UENUM = CDC_RX_ENDPOINT;
+		// a packet may have come since the caller looked
+		if (UEINTX & (1<<RXOUTI)) return 1;
+		UEIENX = (1<<RXOUTE);
+	}
+	if (xSemaphoreTake(usb_rx_semaphore, ticks) != pdTRUE) return 0;
+	return usb_configuration;
+}
+
+// read up to size bytes, sleeping until they have all arrived or
+// timeout ticks have passed (portMAX_DELAY waits forever), and
+// return how many were read.  Only one task at a time may use it,
+// and never from an interrupt.
+uint16_t usb_serial_class::readBlocking(uint8_t *buffer, uint16_t size, portTickType timeout)
+{
+	portTickType start, elapsed, wait;
+	uint16_t count = 0, n;
+
+	start = xTaskGetTickCount();
+	while (count < size) {
+		n = read(buffer + count, size - count);
+		if (n) {
+			count += n;
+			continue;
+		}
+		wait = portMAX_DELAY;
+		if (timeout != portMAX_DELAY) {
+			elapsed = xTaskGetTickCount() - start;
+			if (elapsed >= timeout) break;
+			wait = timeout - elapsed;
+		}
+		if (!receive_wait(wait)) break;
+	}
+	return count;
+}
+
 // discard any buffered input
 void usb_serial_class::flush()
 {
-        uint8_t intr_state;
-
         if (usb_configuration) {
-                intr_state = SREG;
-                cli();
+                InterruptLock lock;
                 UENUM = CDC_RX_ENDPOINT;
                 while ((UEINTX & (1<<RWAL))) {
                         UEINTX = 0x6B;
                 }
-                SREG = intr_state;
         }
 }
 #if 0
@@ -184,35 +327,123 @@ void usb_serial_class::write(uint8_t c)
 	write(&c, 1);
 }
 
+#if configUSB_TX_RING_SIZE
+
+// bytes copied into the ring with interrupts disabled at a time
+#define TX_RING_COPY_MAX 16
+
+// yield to a writer usb_tx_drain() woke, unless in an interrupt
+static inline void transmit_ring_yield(signed portBASE_TYPE woken)
+{
+	if (woken && (SREG & portSREG_I)) taskYIELD();
+}
+
+// wait for usb_tx_drain() to make room in the ring, for as long as
+// the host keeps taking data, and return zero if it stopped.  tail
+// and usb_tx_waiting are set under the lock that found the ring full,
+// so a drain before the task sleeps still gives the semaphore.
+static uint8_t transmit_ring_wait(usb_tx_index_t tail)
+{
+	uint8_t timeout;
+	signed portBASE_TYPE woken;
+
+	// a task sleeps, an interrupt or code before the scheduler
+	// started polls the endpoint itself
+	if ((SREG & portSREG_I) && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		if (xSemaphoreTake(usb_tx_semaphore, portMS_TO_TICKS(TRANSMIT_TIMEOUT) + 1) == pdTRUE) return 1;
+		// the host took data, another writer may have taken the room
+		return usb_tx_tail != tail;
+	}
+	timeout = UDFNUML + TRANSMIT_TIMEOUT;
+	while (1) {
+		{
+			InterruptLock lock;
+			usb_tx_drain(&woken);
+		}
+		if (usb_tx_tail != tail || !usb_configuration) return 1;
+		if (UDFNUML == timeout) return 0;
+	}
+}
+
+// transmit a block of data, through the ring
+static void transmit_block(const uint8_t *buffer, uint16_t size)
+{
+	usb_tx_index_t head, tail, room;
+	uint8_t n;
+	signed portBASE_TYPE woken = pdFALSE;
+
+	while (size) {
+		{
+			// interrupts are disabled so these functions can be
+			// used from the main program or interrupt context,
+			// even both in the same program!
+			InterruptLock lock;
+			// if we're not online (enumerated and configured), error
+			if (!usb_configuration) return;
+			head = usb_tx_head;
+			tail = usb_tx_tail;
+			room = (tail - head - 1) & USB_TX_RING_MASK;
+			if (room) {
+				transmit_previous_timeout = 0;
+				n = (room < TX_RING_COPY_MAX) ? room : TX_RING_COPY_MAX;
+				if (n > size) n = size;
+				size -= n;
+				do {
+					usb_tx_ring[head] = *buffer++;
+					head = (head + 1) & USB_TX_RING_MASK;
+				} while (--n);
+				usb_tx_head = head;
+				// send it now if a bank is free
+				usb_tx_drain(&woken);
+			} else {
+				// if we gave up due to timeout before, don't wait again
+				if (transmit_previous_timeout) return;
+				usb_tx_waiting = 1;
+			}
+		}
+		if (room) {
+			transmit_ring_yield(woken);
+			woken = pdFALSE;
+			continue;
+		}
+		// have we waited too long?  This happens if the user
+		// is not running an application that is listening
+		if (!transmit_ring_wait(tail)) {
+			transmit_previous_timeout = 1;
+			return;
+		}
+	}
+}
+
+#else
+
+// is the transmit FIFO ready to accept data?
+static inline uint8_t transmit_ready(void)
+{
+	InterruptLock lock;
+
+	UENUM = CDC_TX_ENDPOINT;
+	return UEINTX & (1<<RWAL);
+}
+
 // transmit a block of data
-void usb_serial_class::write(const uint8_t *buffer, uint16_t size)
+static void transmit_block(const uint8_t *buffer, uint16_t size)
 {
-	uint8_t timeout, intr_state, write_size;
+	uint8_t timeout, write_size;
 
 	// if we're not online (enumerated and configured), error
 	if (!usb_configuration) return;
-	// interrupts are disabled so these functions can be
-	// used from the main program or interrupt context,
-	// even both in the same program!
-	intr_state = SREG;
-	cli();
-	UENUM = CDC_TX_ENDPOINT;
 	// if we gave up due to timeout before, don't wait again
 	if (transmit_previous_timeout) {
-		if (!(UEINTX & (1<<RWAL))) {
-			SREG = intr_state;
-			return;
-		}
+		if (!transmit_ready()) return;
 		transmit_previous_timeout = 0;
 	}
 	// each iteration of this loop transmits a packet
 	while (size) {
-		// wait for the FIFO to be ready to accept data
+		// wait for the FIFO to be ready to accept data,
+		// with interrupts enabled between the checks
 		timeout = UDFNUML + TRANSMIT_TIMEOUT;
-		while (1) {
-			// are we ready to transmit?
-			if (UEINTX & (1<<RWAL)) break;
-			SREG = intr_state;
+		while (!transmit_ready()) {
 			// have we waited too long?  This happens if the user
 			// is not running an application that is listening
 			if (UDFNUML == timeout) {
@@ -221,22 +452,22 @@ void usb_serial_class::write(const uint8_t *buffer, uint16_t size)
 			}
 			// has the USB gone offline?
 			if (!usb_configuration) return;
-			// get ready to try checking again
-			intr_state = SREG;
-			cli();
-			UENUM = CDC_TX_ENDPOINT;
 		}
 
+		// interrupts are disabled while the packet is written so
+		// these functions can be used from the main program or
+		// interrupt context, even both in the same program!
+		InterruptLock lock;
+		UENUM = CDC_TX_ENDPOINT;
+		// another task or an interrupt may have filled the banks
+		// since the check, wait again
+		if (!(UEINTX & (1<<RWAL))) continue;
+
 		// compute how many bytes will fit into the next packet
 		write_size = CDC_TX_SIZE - UEBCLX;
 		if (write_size > size) write_size = size;
 		size -= write_size;
 
-#define ASM_COPY1(src, dest, tmp) "ld " tmp ", " src "\n\t" "st " dest ", " tmp "\n\t"
-#define ASM_COPY2(src, dest, tmp) ASM_COPY1(src, dest, tmp) ASM_COPY1(src, dest, tmp)
-#define ASM_COPY4(src, dest, tmp) ASM_COPY2(src, dest, tmp) ASM_COPY2(src, dest, tmp)
-#define ASM_COPY8(src, dest, tmp) ASM_COPY4(src, dest, tmp) ASM_COPY4(src, dest, tmp)
-
 #if 1
 		// write the packet
 		do {
@@ -354,9 +585,47 @@ void usb_serial_class::write(const uint8_t *buffer, uint16_t size)
 #endif
 		// if this completed a packet, transmit it now!
 		if (!(UEINTX & (1<<RWAL))) UEINTX = 0x3A;
-		transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
+		transmit_flush_timer = transmit_flush_timeout;
 	}
-	SREG = intr_state;
+}
+
+#endif
+
+// how partially full packets are flushed, see flushPolicy()
+static uint8_t transmit_flush_policy=USB_FLUSH_THROUGHPUT;
+
+// the frame number of the last write, and the average number of
+// frames between writes, times four
+static uint16_t transmit_last_frame=0;
+static uint16_t transmit_write_gap=0;
+
+// set the flush timeout a little above the time between writes, so
+// data written at a steady rate is sent in full packets
+static void transmit_flush_adapt(void)
+{
+	uint16_t frame, gap;
+
+	InterruptLock lock;
+	frame = UDFNUML;
+	frame |= (uint16_t)UDFNUMH << 8;
+	// the frame number has 11 bits
+	gap = (frame - transmit_last_frame) & 0x7FF;
+	// writes in the same frame go in the same packet anyway
+	if (!gap) return;
+	transmit_last_frame = frame;
+	if (gap > 255) gap = 255;
+	transmit_write_gap += gap - (transmit_write_gap >> 2);
+	gap = (transmit_write_gap >> 2) + 1;
+	if (gap > TRANSMIT_FLUSH_TIMEOUT_MAX) gap = 1;
+	transmit_flush_timeout = gap;
+}
+
+// transmit a block of data, and flush it as the policy says
+void usb_serial_class::write(const uint8_t *buffer, uint16_t size)
+{
+	if (transmit_flush_policy == USB_FLUSH_ADAPTIVE) transmit_flush_adapt();
+	transmit_block(buffer, size);
+	if (transmit_flush_policy == USB_FLUSH_LOW_LATENCY) send_now();
 }
 
 // transmit a string
@@ -377,18 +646,112 @@ void usb_serial_class::write(const char *str)
 // we can do is release the FIFO buffer for when the host wants it
 void usb_serial_class::send_now(void)
 {
-        uint8_t intr_state;
+#if configUSB_TX_RING_SIZE
+        signed portBASE_TYPE woken = pdFALSE;
+
+        {
+                InterruptLock lock;
+
+                // the data still in the ring goes as soon as a bank is
+                // free, and the drain releases the last packet when it
+                // is empty
+                if (!usb_configuration) return;
+                usb_tx_flush_pending = 1;
+                usb_tx_drain(&woken);
+        }
+        transmit_ring_yield(woken);
+#else
+        InterruptLock lock;
 
-        intr_state = SREG;
-        cli();
         if (usb_configuration && transmit_flush_timer) {
                 UENUM = CDC_TX_ENDPOINT;
                 UEINTX = 0x3A;
                 transmit_flush_timer = 0;
         }
-        SREG = intr_state;
+#endif
 }
 
+// choose how partially full packets are flushed: USB_FLUSH_THROUGHPUT
+// waits the timeout (in milliseconds, 0 for the default) after the
+// last write, or for a full packet.  USB_FLUSH_LOW_LATENCY sends the
+// data at the end of every write.  USB_FLUSH_ADAPTIVE starts from the
+// timeout and follows the time between writes.
+void usb_serial_class::flushPolicy(uint8_t policy, uint8_t timeout)
+{
+	transmit_flush_policy = policy;
+	transmit_flush_timeout = timeout ? timeout : TRANSMIT_FLUSH_TIMEOUT;
+}
+
+// the flush timeout in use, in milliseconds
+uint8_t usb_serial_class::flushTimeout(void)
+{
+	return transmit_flush_timeout;
+}
+
+#if configUSB_EVENT_QUEUE_LENGTH
+// wait up to timeout ticks for a change of the connection, and return
+// its USB_EVENT_* code, or 0 if none came.  dtr(), baud() and the like
+// tell the state it changed to.  Only one task at a time may wait.
+uint8_t usb_serial_class::waitEvent(portTickType timeout)
+{
+	uint8_t event;
+
+	if (!usb_event_queue) return 0;
+	if (xQueueReceive(usb_event_queue, &event, timeout) != pdTRUE) return 0;
+	return event;
+}
+#endif
+
+#if configUSB_SUSPEND_POWER_DOWN
+// park a task, or the calling one, while the bus is suspended and the
+// CPU powered down.  Returns 0 if USB_SUSPEND_TASKS are registered
+// already.  Unregistered tasks are stopped too, but wherever the power
+// down catches them; registered ones stay suspended until resume even
+// if an external interrupt wakes the CPU.  A task that is suspended
+// already when the bus sleeps is left alone, and stays suspended.
+// Unpark a task before deleting it.
+uint8_t usb_serial_class::parkOnSuspend(xTaskHandle task)
+{
+	SchedulerLock lock;
+	uint8_t i, free = USB_SUSPEND_TASKS;
+
+	if (!task) task = xTaskGetCurrentTaskHandle();
+	for (i=0; i < USB_SUSPEND_TASKS; i++) {
+		if (usb_suspend_tasks[i] == task) return 1;
+		if (!usb_suspend_tasks[i] && free == USB_SUSPEND_TASKS) free = i;
+	}
+	if (free == USB_SUSPEND_TASKS) return 0;
+	usb_suspend_tasks[free] = task;
+	return 1;
+}
+
+// stop parking a task, or the calling one.  Returns 0 if it was not
+// registered.
+uint8_t usb_serial_class::unparkOnSuspend(xTaskHandle task)
+{
+	SchedulerLock lock;
+	uint8_t i;
+
+	if (!task) task = xTaskGetCurrentTaskHandle();
+	for (i=0; i < USB_SUSPEND_TASKS; i++) {
+		if (usb_suspend_tasks[i] == task) {
+			usb_suspend_tasks[i] = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the suspend policy: hook(1) is called in the pend-call task when the
+// host suspends the bus, and powers down unless it returns 0.  After a
+// power down, hook(0) is called on resume, before the parked tasks run
+// again.  NULL, the default, always powers down.
+void usb_serial_class::onSuspend(uint8_t (*hook)(uint8_t suspend))
+{
+	usb_suspend_hook = hook;
+}
+#endif
+
 uint32_t usb_serial_class::baud(void)
 {
 	return *(uint32_t *)cdc_line_coding;
@@ -421,7 +784,123 @@ uint8_t usb_serial_class::rts(void)
 
 
 
+#if configUSB_VENDOR_BULK
+
+// sleep until the interrupt of a vendor endpoint, enabled by the
+// caller, or until the timeout of a transfer that started at start
+// runs out.  Returns zero on timeout.
+static uint8_t vendor_wait(xSemaphoreHandle semaphore, portTickType start, portTickType timeout)
+{
+	portTickType elapsed, wait = portMAX_DELAY;
+
+	if (timeout != portMAX_DELAY) {
+		elapsed = xTaskGetTickCount() - start;
+		if (elapsed >= timeout) return 0;
+		wait = timeout - elapsed;
+	}
+	return xSemaphoreTake(semaphore, wait) == pdTRUE;
+}
+
+// number of bytes left in the packet being read
+uint8_t usb_vendor_class::available(void)
+{
+	InterruptLock lock;
+
+	if (!usb_configuration) return 0;
+	UENUM = VENDOR_RX_ENDPOINT;
+	return UEBCLX;
+}
+
+// read up to size bytes, the packets already received and those
+// arriving within timeout ticks, and return how many were read.
+// A short packet ends the read, as it ends a transfer on the host.
+uint16_t usb_vendor_class::read(uint8_t *buffer, uint16_t size, portTickType timeout)
+{
+	portTickType start = 0;
+	uint16_t count = 0;
+	uint8_t i, n, len;
+
+	if (timeout) start = xTaskGetTickCount();
+	while (size) {
+		{
+			InterruptLock lock;
+			if (!usb_configuration) break;
+			UENUM = VENDOR_RX_ENDPOINT;
+			i = UEINTX;
+			if (i & (1<<RWAL)) {
+				len = UEBCLX;
+				n = (len < size) ? len : size;
+				size -= n;
+				count += n;
+				usb_vendor_rx_offset += n;
+				do {
+					*buffer++ = UEDATX;
+				} while (--n);
+				// if this drained the packet, release it
+				if (UEINTX & (1<<RWAL)) continue;
+				UEINTX = 0x6B;
+				// the length of the whole packet
+				len = usb_vendor_rx_offset;
+				usb_vendor_rx_offset = 0;
+				if (len < VENDOR_RX_SIZE) break;
+				continue;
+			}
+			if (i & (1<<RXOUTI)) {
+				// a zero length packet ends the transfer
+				UEINTX = 0x6B;
+				if (count) break;
+				continue;
+			}
+			if (!timeout) break;
+			UEIENX = (1<<RXOUTE);
+		}
+		if (!vendor_wait(usb_vendor_rx_semaphore, start, timeout)) break;
+	}
+	return count;
+}
+
+// write size bytes, waiting up to timeout ticks for each free bank,
+// and return how many were written.  The last packet is sent at once
+// even if it is short; a write of 0 bytes sends a zero length packet,
+// to end a transfer that was a multiple of the packet size.
+uint16_t usb_vendor_class::write(const uint8_t *buffer, uint16_t size, portTickType timeout)
+{
+	portTickType start = 0;
+	uint16_t count = 0;
+	uint8_t n;
+
+	if (timeout) start = xTaskGetTickCount();
+	while (1) {
+		{
+			InterruptLock lock;
+			if (!usb_configuration) break;
+			UENUM = VENDOR_TX_ENDPOINT;
+			if (UEINTX & (1<<RWAL)) {
+				n = VENDOR_TX_SIZE - UEBCLX;
+				if (n > size) n = size;
+				size -= n;
+				count += n;
+				while (n--) UEDATX = *buffer++;
+				// send it if full, or if this is the end
+				if (!(UEINTX & (1<<RWAL)) || !size) UEINTX = 0x3A;
+				if (!size) break;
+				continue;
+			}
+			if (!timeout) break;
+			UEIENX = (1<<TXINE);
+		}
+		if (!vendor_wait(usb_vendor_tx_semaphore, start, timeout)) break;
+	}
+	return count;
+}
+
+#endif
+
+
 // Preinstantiate Objects //////////////////////////////////////////////////////
 
 usb_serial_class Serial = usb_serial_class();
+#if configUSB_VENDOR_BULK
+usb_vendor_class Vendor = usb_vendor_class();
+#endif
 
@@ -4,19 +4,43 @@
 #include <inttypes.h>
 
 #include "Print.h"
+#include "DuinOS/FreeRTOS.h"
+#include "DuinOS/task.h"
+
+// Serial.flushPolicy()
+#define USB_FLUSH_THROUGHPUT	0
+#define USB_FLUSH_LOW_LATENCY	1
+#define USB_FLUSH_ADAPTIVE	2
+
+// Serial.waitEvent(), with configUSB_EVENT_QUEUE_LENGTH set
+#include "usb_events.h"
 
 class usb_serial_class : public Print
 {
   public:
     void begin(long);
+    void beginAsync(void (*configured)(void) = NULL);
+    uint8_t waitConfigured(portTickType timeout = portMAX_DELAY);
     void end(void);
     uint8_t available(void);
     int read(void);
+    uint16_t read(uint8_t *buffer, uint16_t size);
+    uint16_t readBlocking(uint8_t *buffer, uint16_t size, portTickType timeout = portMAX_DELAY);
     void flush(void);
     virtual void write(uint8_t);
     virtual void write(const uint8_t *buffer, uint16_t size);
     virtual void write(const char *str);
     void send_now(void);
+    void flushPolicy(uint8_t policy, uint8_t timeout = 0);
+    uint8_t flushTimeout(void);
+#if configUSB_EVENT_QUEUE_LENGTH
+    uint8_t waitEvent(portTickType timeout = portMAX_DELAY);
+#endif
+#if configUSB_SUSPEND_POWER_DOWN
+    uint8_t parkOnSuspend(xTaskHandle task = NULL);
+    uint8_t unparkOnSuspend(xTaskHandle task = NULL);
+    void onSuspend(uint8_t (*hook)(uint8_t suspend));
+#endif
     uint32_t baud(void);
     uint8_t stopbits(void);
     uint8_t paritytype(void);
@@ -27,5 +51,44 @@ class usb_serial_class : public Print
 
 extern usb_serial_class Serial;
 
+#if configUSB_SOF_TIMEBASE
+// Time on the host's clock, from its start of frame packets, see
+// configUSB_SOF_TIMEBASE in usb_private.h.  usbHostFrame() counts the
+// frames, 1 ms each, and usbHostMicros() is that count in microseconds
+// plus the time since the last frame began.  Only the low 11 bits of
+// the frame count are the host's frame number, the same on every
+// device of the bus; the upper bits count from when this board first
+// saw the bus.  So two boards agree on usbHostFrame() % 2048 and
+// usbHostMicros() % 2048000, one 2.048 s period of the host: merging
+// longer logs needs a coarse epoch from elsewhere, eg. the host
+// stamping a message to each board.  Within that, timestamps of
+// different boards line up to about the latency of the start of
+// frame interrupt.
+// usbClockPPM() is the drift of the CPU clock against the host,
+// positive if it runs fast, 0 until the first two seconds are up.
+extern "C" {
+uint32_t usbHostFrame(void);
+uint64_t usbHostMicros(void);
+int16_t usbClockPPM(void);
+}
+#endif
+
+#if configUSB_VENDOR_BULK
+// Binary data over the vendor specific bulk endpoints, see
+// configUSB_VENDOR_BULK in usb_private.h.  Data moves straight
+// between the caller's buffer and the endpoint memory, a packet at a
+// time, with no buffer in between.  One task at a time may read, and
+// one write.  Only a timeout of 0 may be used from an interrupt.
+class usb_vendor_class
+{
+  public:
+    uint8_t available(void);
+    uint16_t read(uint8_t *buffer, uint16_t size, portTickType timeout = 0);
+    uint16_t write(const uint8_t *buffer, uint16_t size, portTickType timeout = portMAX_DELAY);
+};
+
+extern usb_vendor_class Vendor;
+#endif
+
 #endif
 
@@ -0,0 +1,13 @@
+#ifndef usb_events_h__
+#define usb_events_h__
+
+// connection changes returned by Serial.waitEvent(), with
+// configUSB_EVENT_QUEUE_LENGTH set; shared by usb.c and usb_api.h
+#define USB_EVENT_CONFIGURED    1
+#define USB_EVENT_RESET         2
+#define USB_EVENT_SUSPEND       3
+#define USB_EVENT_RESUME        4
+#define USB_EVENT_LINE_STATE    5
+#define USB_EVENT_LINE_CODING   6
+
+#endif
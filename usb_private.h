@@ -2,6 +2,9 @@
 #define usb_serial_h__
 
 #include <stdint.h>
+#include "DuinOS/FreeRTOS.h"
+#include "DuinOS/semphr.h"
+#include "DuinOS/task.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -49,8 +52,15 @@ extern "C"{
 // that tells the PC no more data is expected and it should pass
 // any buffered data to the application that may be waiting.  If
 // you want data sent immediately, call usb_serial_flush_output().
+// Serial.flushPolicy() changes the timeout at run time, or flushes
+// after every write.
 #define TRANSMIT_FLUSH_TIMEOUT  3   /* in milliseconds */
 
+// Longest timeout the adaptive flush policy uses.  Writes further
+// apart than this gain nothing from waiting, so they are flushed on
+// the next frame instead.
+#define TRANSMIT_FLUSH_TIMEOUT_MAX  10   /* in milliseconds */
+
 // If the PC is connected but not "listening", this is the length
 // of time before usb_serial_getchar() returns with an error.  This
 // is roughly equivilant to a real UART simply transmitting the
@@ -59,6 +69,56 @@ extern "C"{
 // use to know your data wasn't sent.
 #define TRANSMIT_TIMEOUT        15   /* in milliseconds */
 
+// A RAM ring in front of the transmit endpoint, so writers copy their
+// data and return instead of waiting for the host to take a packet.
+// The start of frame and endpoint interrupts move it to the endpoint.
+// Writers only wait when the ring is full, and give up as above when
+// the host stops taking data.  A power of two up to 32768, or 0 for
+// none; it is usually set in FreeRTOSConfig.h.
+#ifndef configUSB_TX_RING_SIZE
+#define configUSB_TX_RING_SIZE  0
+#endif
+
+// An interface of its own with a bulk endpoint pair, for binary data
+// that should not go through the host's tty layer.  Host software
+// reaches it with libusb, and the sketch with the Vendor object of
+// usb_api.h.  The device becomes a composite of the CDC serial port
+// and this interface.  Set to 1 to enable, usually in
+// FreeRTOSConfig.h.  The AT90USB162 lacks the endpoints.
+#ifndef configUSB_VENDOR_BULK
+#define configUSB_VENDOR_BULK   0
+#endif
+
+// Measure the CPU clock against the host's start of frame packets,
+// exactly 1 ms apart on every device of the bus.  millis() and
+// micros() are then slewed to run at the host's rate, and
+// usbHostMicros() gives timestamps that line up between devices,
+// modulo the 2.048 s period of the host's frame number.
+// Set to 1 to enable, usually in FreeRTOSConfig.h.
+#ifndef configUSB_SOF_TIMEBASE
+#define configUSB_SOF_TIMEBASE  0
+#endif
+
+// Connection changes are queued for a task in Serial.waitEvent():
+// configuration, bus reset, suspend, resume, and the control line
+// state and line coding set by the host.  The number of events that
+// can be pending, or 0 for none.  Usually set in FreeRTOSConfig.h.
+#ifndef configUSB_EVENT_QUEUE_LENGTH
+#define configUSB_EVENT_QUEUE_LENGTH  0
+#endif
+
+// Sleep in power down mode while the host keeps the bus suspended, to
+// stay within the 2.5 mA the USB spec allows.  The pend-call task asks
+// the hook set with Serial.onSuspend(), parks the tasks registered
+// with Serial.parkOnSuspend(), and sleeps until the host resumes the
+// bus.  The tick stops with the CPU, so no task runs and millis()
+// does not count the time asleep.  Needs configUSE_PEND_CALL_TASK
+// and an F_CPU of 8 MHz or more.  Set to 1 to enable, usually in
+// FreeRTOSConfig.h.
+#ifndef configUSB_SUSPEND_POWER_DOWN
+#define configUSB_SUSPEND_POWER_DOWN  0
+#endif
+
 
 /**************************************************************************
  *
@@ -88,6 +148,30 @@ extern "C"{
 #define CDC_TX_SIZE             64
 #endif
 
+#if configUSB_VENDOR_BULK
+#if defined(__AVR_AT90USB162__)
+#error "configUSB_VENDOR_BULK needs endpoints 5 and 6, which the AT90USB162 does not have"
+#endif
+#define VENDOR_INTERFACE        2
+#define VENDOR_RX_ENDPOINT      5
+#define VENDOR_RX_SIZE          64
+#define VENDOR_RX_BUFFER        EP_DOUBLE_BUFFER
+#define VENDOR_TX_ENDPOINT      6
+#define VENDOR_TX_SIZE          64
+#define VENDOR_TX_BUFFER        EP_DOUBLE_BUFFER
+#endif
+
+#if configUSB_SUSPEND_POWER_DOWN
+#if !configUSE_PEND_CALL_TASK
+#error "configUSB_SUSPEND_POWER_DOWN needs configUSE_PEND_CALL_TASK"
+#endif
+#if (F_CPU < 8000000L)
+#error "configUSB_SUSPEND_POWER_DOWN needs F_CPU of 8 MHz or more, WAKEUPI does not work with the USB clock frozen below that"
+#endif
+// the most tasks Serial.parkOnSuspend() takes
+#define USB_SUSPEND_TASKS       4
+#endif
+
 
 
 
@@ -100,8 +184,10 @@ extern volatile uint8_t usb_configuration;
 extern volatile uint8_t usb_suspended;
 
 // the time remaining before we transmit any partially full
-// packet, or send a zero length packet.
+// packet, or send a zero length packet, and what it is set to
+// after each write.
 extern volatile uint8_t transmit_flush_timer;
+extern volatile uint8_t transmit_flush_timeout;
 extern uint8_t transmit_previous_timeout;
 
 // serial port settings (baud rate, control signals, etc) set
@@ -110,8 +196,76 @@ extern uint8_t transmit_previous_timeout;
 extern volatile uint8_t cdc_line_coding[7];
 extern volatile uint8_t cdc_line_rtsdtr;
 
+// given by the CDC RX endpoint interrupt when a packet arrives, while a
+// task sleeps in Serial.readBlocking()
+extern xSemaphoreHandle usb_rx_semaphore;
+
+// given when the host sets a configuration, and the function
+// Serial.beginAsync() asked to be called then
+extern xSemaphoreHandle usb_configured_semaphore;
+extern void (*volatile usb_configured_hook)(void);
+
+#if configUSB_SOF_TIMEBASE
+// the host's frame number counted on past its 11 bits, the tick timer
+// (ulPortGetTimestamp()) at its start of frame interrupt, and the
+// measured drift of the CPU clock, in ppm
+extern volatile uint32_t usb_sof_frame;
+extern volatile uint32_t usb_sof_timestamp;
+extern volatile int16_t usb_sof_ppm;
+// in pins_teensy.c, slews millis() and micros() by the drift
+void timebase_adjust(int ppm);
+#endif
+
+#if configUSB_VENDOR_BULK
+// given by the vendor endpoint interrupts, when a packet arrives or
+// a bank is free, to the task sleeping in Vendor.read() or write()
+extern xSemaphoreHandle usb_vendor_rx_semaphore;
+extern xSemaphoreHandle usb_vendor_tx_semaphore;
+// bytes read from the packet in the RX bank, so a read that resumes
+// in it knows the length it arrived with; cleared when the endpoints
+// are reset
+extern uint8_t usb_vendor_rx_offset;
+#endif
+
+#if configUSB_TX_RING_SIZE
+#if configUSB_TX_RING_SIZE > 256
+typedef uint16_t usb_tx_index_t;
+#else
+typedef uint8_t usb_tx_index_t;
+#endif
+// the transmit ring: written at head by Serial.write(), read at tail
+// by usb_tx_drain(), which must be called with interrupts disabled.
+// A writer waiting for room sets usb_tx_waiting and sleeps on
+// usb_tx_semaphore.
+extern uint8_t usb_tx_ring[configUSB_TX_RING_SIZE];
+extern volatile usb_tx_index_t usb_tx_head, usb_tx_tail;
+extern volatile uint8_t usb_tx_waiting;
+// set by Serial.send_now() to release the last packet once the
+// ring is empty
+extern volatile uint8_t usb_tx_flush_pending;
+extern xSemaphoreHandle usb_tx_semaphore;
+void usb_tx_drain(signed portBASE_TYPE *woken);
+#define USB_TX_RING_MASK        ((usb_tx_index_t)(configUSB_TX_RING_SIZE - 1))
+#endif
+
+#if configUSB_EVENT_QUEUE_LENGTH
+// the queue of USB_EVENT_* codes read by Serial.waitEvent(), and the
+// function the interrupts add to it with, interrupts disabled
+extern xQueueHandle usb_event_queue;
+void usb_event(uint8_t event, signed portBASE_TYPE *woken);
+#endif
+
+#if configUSB_SUSPEND_POWER_DOWN
+// the tasks parked in power down, and the hook that may veto it
+extern xTaskHandle usb_suspend_tasks[USB_SUSPEND_TASKS];
+extern uint8_t (*volatile usb_suspend_hook)(uint8_t suspend);
+#endif
+
 
 
+// events for Serial.waitEvent()
+#include "usb_events.h"
+
 // constants corresponding to the various serial parameters
 #define USB_SERIAL_DTR                  0x01
 #define USB_SERIAL_RTS                  0x02
@@ -151,7 +305,11 @@ extern volatile uint8_t cdc_line_rtsdtr;
 			((s) == 16 ? 0x10 :	\
 			             0x00)))
 
+#if configUSB_VENDOR_BULK
+#define MAX_ENDPOINT		6
+#else
 #define MAX_ENDPOINT		4
+#endif
 
 #define LSB(n) (n & 255)
 #define MSB(n) ((n >> 8) & 255)
@@ -100,6 +100,7 @@ void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, byte val);
 
 void attachInterrupt(uint8_t, void (*)(void), uint8_t mode);
 void detachInterrupt(uint8_t);
+void attachDeferredInterrupt(uint8_t, void (*)(void), uint8_t mode);	// needs configUSE_PEND_CALL_TASK
 
 void setup(void);
 void loop(void);